@@ -1,468 +1,5238 @@
 #include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <charconv>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <csignal>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <filesystem>
 #include <fstream>
+#include <functional>
 #include <iomanip>
 #include <iostream>
 #include <memory>
+#include <mutex>
+#include <sstream>
 #include <string>
+#include <string_view>
+#include <thread>
 #include <vector>
 
+#if defined(_WIN32)
+#include <malloc.h>
+#include <sys/stat.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+//x86 SIMD scoring kernels are compiled with per-function target attributes and picked at runtime, so the binary still runs on any x86 CPU
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define QUIZ_X86_KERNELS 1
+#include <immintrin.h>
+#else
+#define QUIZ_X86_KERNELS 0
+#endif
+
 using namespace std;
 
-//Create a structure to represent our contestant, who has an ID and answer choices
+//Size of one CPU cache line; answer rows are aligned to and padded out to a multiple of this
+constexpr size_t cacheLineSize{ 64 };
+
+//Helper to count the set bits in a 64-bit word (a single instruction on CPUs with popcount)
+inline size_t countSetBits(uint64_t bits)
+{
+#if defined(__GNUC__)
+	return static_cast<size_t>(__builtin_popcountll(bits));
+#else
+	size_t count{ 0 };
+	for (; bits != 0; bits &= bits - 1)
+	{
+		++count;
+	}
+	return count;
+#endif
+}
+
+//Helper to find the position of the lowest set bit in a non-zero 64-bit word
+inline size_t lowestSetBit(uint64_t bits)
+{
+#if defined(__GNUC__)
+	return static_cast<size_t>(__builtin_ctzll(bits));
+#else
+	size_t position{ 0 };
+	for (; (bits & 1) == 0; bits >>= 1)
+	{
+		++position;
+	}
+	return position;
+#endif
+}
+
+//Create a structure to represent our contestant, who has an ID (the answer choices live in the 'AnswerMatrix', one row per contestant)
 struct Contestant
 {
 	string id{};				   //create a string object to store the contestant ID in
-	unique_ptr<char[]> answers{};  //create a unique pointer to a character array to store the contestant's answers
+};
+
+//Deleter for memory obtained from cache-line-aligned 'operator new[]', so it can be owned by a unique_ptr
+template <typename T>
+struct AlignedDeleter
+{
+	void operator()(T* memory) const { ::operator delete[](memory, align_val_t{ cacheLineSize }); }
+};
+
+/* Function to allocate 'count' zeroed elements in a block that starts on a cache line and is padded out to a whole number of cache lines,
+   so no other allocation can share a cache line with it */
+template <typename T>
+unique_ptr<T[], AlignedDeleter<T>> allocateAligned(size_t count)
+{
+	size_t bytes{ (count * sizeof(T) + cacheLineSize - 1) / cacheLineSize * cacheLineSize };
+	bytes = max(bytes, cacheLineSize); //always hand out at least one line
+	unique_ptr<T[], AlignedDeleter<T>> block(static_cast<T*>(::operator new[](bytes, align_val_t{ cacheLineSize })));
+	memset(static_cast<void*>(block.get()), 0, bytes);
+	return block;
+}
+
+/* Create a structure to store every contestant's answers in one contiguous, cache-aligned block :
+   row i holds contestant i's answers, followed by zero padding up to 'rowStride' bytes.
+   one allocation for the whole table (instead of one per contestant) keeps rows next to each other in memory,
+   and the padding lets the scoring kernel compare whole 16/32-byte chunks without a leftover loop */
+struct AnswerMatrix
+{
+	unique_ptr<char[], AlignedDeleter<char>> data{}; //all rows, back to back
+	size_t rowStride{ 0 };					   //bytes per row: number of questions rounded up to a multiple of 'cacheLineSize'
+	size_t capacity{ 0 };					   //number of rows allocated
+
+	char* row(size_t i) { return data.get() + i * rowStride; }
+	const char* row(size_t i) const { return data.get() + i * rowStride; }
+};
+
+/* The distinct answer rows of a loaded contestant file ('--dedup') :
+   every row is hashed and looked up in an open-addressing table, and a row not seen before is copied into 'rows' (the arena),
+   so each distinct answer pattern is scored and formatted once, however many contestants share it */
+struct AnswerPatterns
+{
+	AnswerMatrix rows{};					//one copy of each distinct answer row, in order of first appearance
+	size_t numPatterns{ 0 };
+	unique_ptr<size_t[]> patternOf{};		//pattern of each contestant
+	unique_ptr<size_t[]> contestantsWith{};	//number of contestants with each pattern
+};
+
+/* Layout of one question's row of item-analysis option tallies : a [count, score sum] pair for every possible answer byte
+   (so an answer is its own column index), plus one cache line of padding so that successive questions' rows do not all
+   fall into the same cache sets (the rows would otherwise be exactly 4 KiB apart) */
+constexpr size_t answerValues{ 256 };
+constexpr size_t itemRowWords{ 2 * answerValues + cacheLineSize / sizeof(size_t) };
+
+/* Per-question answer counts for item analysis ('--items'), filled in by the scoring pass alongside the scores :
+   together with the score histogram they give every option's frequency and mean score, the point-biserial correlations
+   and the upper/lower group discrimination indices without reading the answers again */
+struct ItemCounts
+{
+	unique_ptr<size_t[]> optionTallies{};	//numQuestions rows of 'itemRowWords': for each answer, how many gave it and the sum of their numbers of correct answers
+	unique_ptr<size_t[]> correctByScore{};	//numQuestions x (numQuestions + 1): contestants with each number of correct answers who got each question right
+};
+
+//Create a structure to hold everything the single scoring pass produces
+/* How score histogram positions turn into scores : position k counts the contestants with 'lowestMarks + k' marks, out of 'totalMarks'.
+   with the plain scheme (one mark per question) the positions are numbers of correct answers, so 'lowestMarks' is 0 and 'totalMarks' the number of questions */
+struct ScoreScale
+{
+	size_t levels{ 0 };		  //positions in the histogram
+	int64_t lowestMarks{ 0 }; //marks at position 0 (negative with negative marking)
+	int64_t totalMarks{ 0 };  //marks for getting every question right, a score of 100
+	//score (percent) at position 'level'; for the plain scheme this is exactly 'correct answers / questions * 100', as it always was
+	double score(size_t level) const { return static_cast<double>(lowestMarks + static_cast<int64_t>(level)) / static_cast<double>(totalMarks) * 100.00; }
+};
+
+//How marks are given (chosen by the scheme file next to the answer key; without one every quiz uses the plain scheme)
+enum class ScoringPolicy
+{
+	Plain,			//one mark per correct answer
+	Weighted,		//each question's own marks for a correct answer; wrong and blank answers get nothing
+	NegativeMarking //as weighted, but wrong answers lose marks; blank answers still get nothing
+};
+
+//Entries per 64-bit mask word in a marks table: 256 for each of its 8 bytes
+constexpr size_t marksTableWordEntries{ 8 * 256 };
+
+//The answer that means a question was left blank when a quiz has no scheme file (or its scheme file does not name one)
+constexpr char defaultBlankAnswer{ '-' };
+
+/* A quiz's scoring scheme, read from the descriptor file next to its answer key :
+   a marks table holds, for every group of 8 questions, the total marks of each of the 256 subsets of that group,
+   so the marks of a 64-bit question mask take 8 table lookups, with no loop over its bits and no branches */
+struct ScoringScheme
+{
+	ScoringPolicy policy{ ScoringPolicy::Plain };
+	ScoreScale scale{};						  //histogram positions and scores for this scheme
+	char blankAnswer{ defaultBlankAnswer };	  //the answer that means a question was left blank
+	unique_ptr<int32_t[]> correctMarkTable{}; //marks for correct answers (weighted schemes only)
+	unique_ptr<int32_t[]> wrongMarkTable{};	  //marks, zero or negative, for wrong answers (negative marking only)
+	unique_ptr<char[], AlignedDeleter<char>> blankRow{}; //a padded row of blank answers, so the scoring kernel can find blanks (negative marking only)
+};
+
+struct ScoringResults
+{
+	unique_ptr<double[]> allScores{};			   //score (percent) of each contestant
+	unique_ptr<size_t[]> missedQuestionsCounter{}; //number of contestants who missed each question
+	unique_ptr<size_t[]> scoreHistogram{};		   //number of contestants at each position of 'scale' (with the plain scheme, each count of correct answers)
+	ScoreScale scale{};							   //how histogram positions turn into scores
+	unique_ptr<uint64_t[]> wrongQuestionMasks{};   //'maskWords' words per contestant; bit j set means question j was answered incorrectly
+	size_t maskWords{ 0 };						   //64-bit words per contestant in 'wrongQuestionMasks' (one per cache line of the answer row)
+	ItemCounts items{};							   //item-analysis counts; empty unless requested
+};
+
+//Signature of the scoring kernels: compare one padded row against the padded answer key, fill its wrong-question mask and return the number of wrong answers
+using RowScoringKernel = size_t(*)(const char* row, const char* key, size_t rowStride, uint64_t* wrongMask);
+
+//Create a structure to hold one scoring thread's own counters; each array is cache-line aligned and padded, so two threads never write to the same cache line
+struct WorkerTallies
+{
+	unique_ptr<size_t[], AlignedDeleter<size_t>> missedQuestionsCounter{}; //this thread's miss count per question
+	unique_ptr<size_t[], AlignedDeleter<size_t>> scoreHistogram{};		   //this thread's count of contestants per histogram position
+	unique_ptr<size_t[], AlignedDeleter<size_t>> optionTallies{};		   //this thread's share of 'ItemCounts' (only allocated for item analysis)
+	unique_ptr<size_t[], AlignedDeleter<size_t>> correctByScore{};
+};
+
+//One scoring thread's share of the contestant chunks; other threads steal from the same counter once their own share runs out
+struct alignas(cacheLineSize) ChunkQueue
+{
+	atomic<size_t> nextChunk{ 0 }; //next chunk to hand out
+	size_t endChunk{ 0 };		   //one past the last chunk in this share
+};
+
+/* Header of a packed contestant file (written by '--compile'), followed by three sections :
+   the id offsets ('numContestants' + 1 offsets into the id bytes), all ids back to back, and the answer rows.
+   each answer is stored as its position in 'alphabet' using 'bitsPerAnswer' bits, packed into 64-bit words, one row of 'rowWords' words per contestant.
+   all numbers are in native byte order */
+struct PackedFileHeader
+{
+	char magic[4];				//"QPK1"
+	uint32_t bitsPerAnswer;		//2 (alphabet of up to 4 options) or 4 (up to 16 options)
+	uint64_t numQuestions;		//answers per contestant
+	uint64_t numContestants;	//number of contestants (rows)
+	uint64_t rowWords;			//64-bit words per contestant row
+	uint64_t idOffsetsOffset;	//file offset of the id offsets
+	uint64_t idBytesOffset;		//file offset of the id bytes
+	uint64_t answersOffset;		//file offset of the answer rows (8-byte aligned)
+	uint32_t alphabetSize;		//number of distinct answers used in the file
+	char alphabet[16];			//the answers, in code order
+	char reserved[4];			//zero
+};
+static_assert(sizeof(PackedFileHeader) == 80, "packed file header layout must not depend on the compiler");
+
+//Read-only view of a memory-mapped packed contestant file: ids and packed answer rows are used in place, nothing is unpacked up front
+struct PackedContestants
+{
+	const PackedFileHeader* header{ nullptr };
+	const uint64_t* idOffsets{ nullptr };
+	const char* idBytes{ nullptr };
+	const uint64_t* answerRows{ nullptr };
+
+	size_t fieldsPerWord() const { return 64 / header->bitsPerAnswer; }
+	string_view id(size_t i) const { return string_view(idBytes + *(idOffsets + i), static_cast<size_t>(*(idOffsets + i + 1) - *(idOffsets + i))); }
+	const uint64_t* row(size_t i) const { return answerRows + i * header->rowWords; }
+	//decode contestant i's answer to question j
+	char answer(size_t i, size_t j) const
+	{
+		uint64_t code{ (*(row(i) + j / fieldsPerWord()) >> ((j % fieldsPerWord()) * header->bitsPerAnswer)) & ((uint64_t{ 1 } << header->bitsPerAnswer) - 1) };
+		return header->alphabet[code];
+	}
+};
+
+/* Header of a contestant index (built by '--query' or '--save-index', loaded by '--index'), followed by six sections :
+   the cumulative score counts, the hash table, the id offsets, the ids, each contestant's number of correct answers and their wrong-question masks.
+   the bytes are the same in memory and on disk, so a saved index is queried straight from the mapped file. all numbers are in native byte order */
+struct IndexFileHeader
+{
+	char magic[4];				  //"QIX1"
+	uint32_t maskWords;			  //64-bit wrong-question mask words per contestant
+	uint64_t numQuestions;		  //questions in the quiz
+	uint64_t numContestants;	  //contestants indexed
+	uint64_t tableSlots;		  //hash table size: a power of two, at least twice the number of contestants
+	uint64_t atOrAboveOffset;	  //file offset of the cumulative score counts (numQuestions + 2 of them)
+	uint64_t slotsOffset;		  //file offset of the hash table
+	uint64_t idOffsetsOffset;	  //file offset of the id offsets ('numContestants' + 1 offsets into the id bytes)
+	uint64_t idBytesOffset;		  //file offset of the id bytes
+	uint64_t correctCountsOffset; //file offset of the numbers of correct answers (one 32-bit count per contestant, 8-byte aligned)
+	uint64_t wrongMasksOffset;	  //file offset of the wrong-question masks (8-byte aligned)
+	uint64_t totalBytes;		  //size of the whole index
+};
+static_assert(sizeof(IndexFileHeader) == 88, "index file header layout must not depend on the compiler");
+
+//One hash table slot: the id's hash (so nearly every mismatch is rejected without comparing ids) and the contestant's row
+struct IndexSlot
+{
+	uint64_t hash;
+	uint64_t row; //'ContestantIndex::notFound' if the slot is empty
+};
+
+//Helper to hash bytes with 64-bit FNV-1a, continuing from 'hash' (the inputs are short, so a byte at a time is fast enough)
+inline uint64_t hashBytes(const void* data, size_t size, uint64_t hash = 0xCBF29CE484222325ull)
+{
+	for (size_t k = 0; k < size; ++k)
+	{
+		hash = (hash ^ *(static_cast<const unsigned char*>(data) + k)) * 0x100000001B3ull;
+	}
+	return hash;
+}
+
+//Helper to hash a contestant id for the index
+inline uint64_t hashContestantId(string_view id)
+{
+	return hashBytes(id.data(), id.size());
+}
+
+//Helper to check that a file section of 'count' entries of 'entrySize' bytes, starting at 'offset', lies inside a file of 'size' bytes (written so nothing can overflow)
+inline bool sectionFits(uint64_t offset, uint64_t count, uint64_t entrySize, uint64_t size)
+{
+	return offset <= size && count <= (size - offset) / entrySize;
+}
+
+/* Read-only view of a contestant index, built in memory after scoring or mapped from a saved index file :
+   'find' probes an open-addressing hash table (linear probing, never more than half full) from id to row,
+   and ranks and percentiles come from the cumulative score counts, so every query takes constant time */
+struct ContestantIndex
+{
+	static constexpr size_t notFound{ ~size_t{ 0 } };
+
+	const IndexFileHeader* header{ nullptr };
+	const uint64_t* atOrAbove{ nullptr };	   //atOrAbove[k]: contestants with k or more correct answers (k = 0 to numQuestions + 1)
+	const IndexSlot* slots{ nullptr };
+	const uint64_t* idOffsets{ nullptr };
+	const char* idBytes{ nullptr };
+	const uint32_t* correctCounts{ nullptr };
+	const uint64_t* wrongMasks{ nullptr };
+
+	string_view id(size_t row) const { return string_view(idBytes + *(idOffsets + row), static_cast<size_t>(*(idOffsets + row + 1) - *(idOffsets + row))); }
+	size_t correctCount(size_t row) const { return *(correctCounts + row); }
+	const uint64_t* wrongMask(size_t row) const { return wrongMasks + row * header->maskWords; }
+
+	//row of the contestant with this id, or 'notFound'
+	size_t find(string_view contestantId) const
+	{
+		uint64_t hash{ hashContestantId(contestantId) };
+		uint64_t slotMask{ header->tableSlots - 1 };
+		for (uint64_t slot = hash & slotMask; (slots + slot)->row != notFound; slot = (slot + 1) & slotMask)
+		{
+			if ((slots + slot)->hash == hash && id((slots + slot)->row) == contestantId)
+			{
+				return (slots + slot)->row;
+			}
+		}
+		return notFound;
+	}
+	//1 for the best score; tied contestants share a rank (one more than the number who scored higher)
+	size_t rank(size_t row) const { return *(atOrAbove + correctCount(row) + 1) + 1; }
+	//percentile rank: the percentage of contestants who scored lower, counting half of those tied
+	double percentile(size_t row) const
+	{
+		size_t k{ correctCount(row) };
+		double below{ static_cast<double>(header->numContestants - *(atOrAbove + k)) };
+		double tied{ static_cast<double>(*(atOrAbove + k) - *(atOrAbove + k + 1)) };
+		return (below + tied / 2.0) / static_cast<double>(header->numContestants) * 100.0;
+	}
+};
+
+//A contestant index built in memory: the index bytes (laid out exactly like an index file) and a view of them
+struct BuiltContestantIndex
+{
+	unique_ptr<char[], AlignedDeleter<char>> data{};
+	size_t sizeInBytes{ 0 };
+	ContestantIndex index{};
+};
+
+/* Header of a partial summary ('--partial FILE'), written by one shard of a sharded run and combined with the others by '--merge' :
+   followed by the score histogram ('levels' counts) and the miss counter of every question ('numQuestions' counts), all u64 in native byte order.
+   every figure is an exact integer sum, so adding up the partials of all the shards gives exactly the totals of a single run */
+struct PartialSummaryHeader
+{
+	char magic[4];			  //"QPS1"
+	uint32_t shardIndex;	  //which shard this is, 1 to 'shardCount'
+	uint32_t shardCount;	  //number of shards the contestant file was cut into
+	uint32_t reserved;		  //always 0
+	uint64_t quizFingerprint; //hash of the answer key and scoring scheme: only partials of the same quiz can be merged
+	uint64_t numQuestions;	  //questions in the quiz
+	uint64_t numContestants;  //contestants this shard scored
+	uint64_t levels;		  //score histogram positions
+	int64_t lowestMarks;	  //the score scale (see 'ScoreScale')
+	int64_t totalMarks;
+	int64_t marksSum;		  //every contestant's marks added up, checked against the histogram when merging
+	uint64_t sliceBegin;	  //byte range of the contestant file this shard scored
+	uint64_t sliceEnd;
+};
+static_assert(sizeof(PartialSummaryHeader) == 88, "partial summary header layout must not depend on the compiler");
+
+//Output formats for the contestant reports ('--format')
+enum class ReportFormat
+{
+	Text,	   //the original console report: "id - score", then missed questions, given answers and correct answers
+	Csv,	   //one row per contestant with a header row
+	JsonLines, //one JSON object per line
+	Binary	   //compact binary records for downstream loaders (layout described in the README)
+};
+
+/* Buffered writer for contestant reports :
+   every record is formatted into one large reusable buffer (numbers with 'to_chars', no stream formatting and no allocation per contestant)
+   which is handed to the output stream in big blocks. the buffer is flushed when it is nearly full, by 'flush', and by the destructor */
+class ReportWriter
+{
+public:
+	ReportWriter(ostream& out, ReportFormat format, size_t numQuestions);
+	~ReportWriter();
+	//flush, then start a new report (with its own header) on another stream, keeping the buffer
+	void restart(ostream& newOut, ReportFormat newFormat, size_t newNumQuestions);
+
+	ReportWriter(const ReportWriter&) = delete;
+	ReportWriter& operator=(const ReportWriter&) = delete;
+
+	//format one contestant's report; 'wrongMask' marks the questions they got wrong and 'answerRow' holds their answers
+	void writeContestant(string_view id, double score, const uint64_t* wrongMask, size_t maskWords, const char* answerRow, const char* correctAnswers);
+	//the same, with everything after the id formatted in advance by 'formatPatternPart'
+	void writeContestant(string_view id, string_view patternPart);
+	//format everything in a report that depends only on the answers (not the id), appending it to 'parts' instead of writing it
+	void formatPatternPart(string& parts, double score, const uint64_t* wrongMask, size_t maskWords, const char* answerRow, const char* correctAnswers);
+	void flush();													  //hand everything formatted so far to the output stream
+	size_t bytesWritten() const { return totalBytes + used; }		  //bytes formatted so far (flushed or not)
+	ReportFormat reportFormat() const { return format; }
+
+private:
+	void writeHeader();					   //CSV header row or binary file header, if the format has one
+	void putId(string_view id);			   //the start of a record, up to and including the id
+	void putPatternPart(double score, const uint64_t* wrongMask, size_t maskWords, const char* answerRow, const char* correctAnswers); //the rest of it
+	void reserve(size_t bytes);			   //make sure 'bytes' more bytes fit in the buffer, flushing (or growing it) if needed
+	void put(char c) { *(buffer.get() + used++) = c; }
+	void put(const char* text, size_t length);
+	void putNumber(size_t number);
+	void putScore(double score);		   //fixed notation, two decimal places (like 'fixed << setprecision(2)')
+	void putEscaped(string_view text);	   //JSON string contents
+	void putRaw(const void* bytes, size_t length) { put(static_cast<const char*>(bytes), length); }
+
+	ostream* out{ nullptr };				//destination of the reports
+	ReportFormat format{ ReportFormat::Text };
+	size_t numQuestions{ 0 };				//questions per contestant (bounds the size of one record)
+	size_t bufferSize{ 1024 * 1024 };		//buffer capacity in bytes
+	unique_ptr<char[]> buffer{};			//formatted output not yet handed to 'out'
+	size_t used{ 0 };						//bytes of 'buffer' in use
+	size_t totalBytes{ 0 };					//bytes already handed to 'out'
+};
+
+//Answer patterns the synthetic quiz generator can produce ('--profile')
+enum class AnswerProfile
+{
+	Uniform,  //every answer picked at random, so scores bunch up around one over the number of options
+	Ability,  //each contestant has an ability and each question a difficulty, giving a realistic spread of scores
+	Clustered //contestants copy one of a few shared answer sheets with a little noise, giving many identical rows
+};
+
+/* Small deterministic random number generator (SplitMix64) for synthetic quizzes :
+   the same seed gives the same quiz on every platform and compiler, which the standard library distributions do not promise */
+struct SplitMix64
+{
+	uint64_t state{ 0 };
+
+	uint64_t next()
+	{
+		uint64_t z{ state += 0x9E3779B97F4A7C15ull };
+		z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+		z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+		return z ^ (z >> 31);
+	}
+	double nextUnit() { return static_cast<double>(next() >> 11) * (1.0 / 9007199254740992.0); } //uniform in [0, 1)
+	size_t below(size_t n) { return static_cast<size_t>(next() % n); }							  //uniform in [0, n)
+};
+
+//Stream buffer that throws away everything written to it, so benchmarks can time report formatting without the cost of a device
+class NullStreamBuffer : public streambuf
+{
+protected:
+	int overflow(int c) override { return traits_type::not_eof(c); }
+	streamsize xsputn(const char*, streamsize count) override { return count; }
+};
+
+/* The quiz files written by '--benchmark', in the system temp directory : they are removed when the benchmark returns,
+   by the destructor if the program exits part-way instead (a loader that cannot read its file calls 'exit', which still destroys globals),
+   and by 'removeBenchmarkFilesOnSignal' if the run is interrupted */
+struct BenchmarkTempFiles
+{
+	string answerKeyFilename{};
+	string contestantsFilename{};
+
+	void removeAll()
+	{
+		error_code ignored{};
+		for (string* filename : { &answerKeyFilename, &contestantsFilename })
+		{
+			if (!filename->empty())
+			{
+				filesystem::remove(*filename, ignored);
+				filename->clear();
+			}
+		}
+	}
+	~BenchmarkTempFiles() { removeAll(); }
+};
+
+//Create a structure to hold the options given on the command line
+struct ProgramOptions
+{
+	string answerKeyFilename{};	  //answer key file name (prompted for if not given on the command line)
+	string contestantsFilename{}; //contestant file name (prompted for if not given on the command line)
+	bool showStats{ false };	  //'--stats': print per-stage time, throughput, allocations and peak memory to the error stream
+	string statsJsonFilename{};	  //'--stats-json FILE': write the same per-stage figures to FILE as JSON
+	size_t numThreads{ 1 };		  //'--threads N': number of scoring threads
+	bool showScalingTable{ false }; //'--scaling': time the scoring pass with 1 to 'numThreads' threads
+	vector<double> percentiles{};	//'--percentile P' (repeatable): extra percentiles to print in the summary
+	bool streamContestants{ false }; //'--stream': read, score and report the contestant file in batches instead of loading it all
+	size_t batchSize{ 65536 };		//'--batch-size N': contestants per batch in streaming and pipelined modes
+	bool pipelineContestants{ false }; //'--pipeline': read, score and report batches on separate threads at the same time
+	size_t queueDepth{ 4 };			//'--queue-depth N': batches each pipeline queue holds before its producer has to wait
+	ReportFormat reportFormat{ ReportFormat::Text }; //'--format text|csv|json|binary': contestant report format
+	string reportFilename{};		//'--output FILE': write contestant reports here instead of the console
+	string compileFilename{};		//'--compile FILE': write the contestant file in packed binary form to FILE and stop
+	bool watchContestants{ false };	//'--watch': keep scoring lines appended to the contestant file, answering commands on standard input
+	size_t pollMilliseconds{ 500 };	//'--poll-ms N': how often '--watch' checks the contestant file for new lines
+	string manifestFilename{};		//'--batch MANIFEST': score every quiz listed in MANIFEST on one shared thread pool
+	string itemReportFilename{};	//'--items FILE': also count every answer during scoring and write an item analysis to FILE
+	bool generateQuiz{ false };		//'--generate': write a synthetic answer key and contestant file to the two file names given, then stop
+	bool runBenchmarks{ false };	//'--benchmark': time every stage on synthetic quizzes of growing size and print the results as JSON Lines
+	size_t generateContestants{ 1000 }; //'--contestants N': contestants in a generated quiz
+	size_t generateQuestions{ 50 };	//'--questions N': questions in a generated quiz (and in every benchmark quiz)
+	string alphabet{ "ABCD" };		//'--alphabet CHARS': answer options of generated quizzes
+	AnswerProfile answerProfile{ AnswerProfile::Ability }; //'--profile uniform|ability|clustered': how generated answers relate to the key
+	uint64_t seed{ 1 };				//'--seed N': generated quizzes depend only on the seed and the settings above
+	size_t benchmarkMaxContestants{ 1000000 }; //'--bench-max N': the largest benchmark quiz (sizes go 1000, 10000, ... up to N)
+	bool queryContestants{ false };	//'--query': after the run, answer contestant ids read from standard input with score, rank and percentile
+	string saveIndexFilename{};		//'--save-index FILE': write the contestant index to FILE for later '--index' queries
+	string indexFilename{};			//'--index FILE': answer queries from standard input with a saved index, without scoring anything
+	size_t shardIndex{ 1 };			//'--shard K/N': score only the K-th of N equal byte ranges of the contestant file (1 of 1 is the whole file)
+	size_t shardCount{ 1 };
+	string partialFilename{};		//'--partial FILE': write the partial summary of this shard to FILE instead of printing a summary
+	bool mergePartials{ false };	//'--merge': print the summary of the partial summary files given, as one run over the whole file would
+	vector<string> partialFilenames{}; //the partial summary files given to '--merge'
+	bool dedupAnswers{ false };		//'--dedup': score and format each distinct answer row once, for every contestant who gave it
+	string clustersFilename{};		//'--clusters FILE': with '--dedup', write every group of contestants with identical answers to FILE as CSV
+};
+
+//Totals for one named pipeline stage, added to every time the stage runs
+struct StageTotals
+{
+	const char* name{ nullptr };
+	size_t calls{ 0 };				//times the stage ran
+	double seconds{ 0.0 };			//wall time over all runs
+	size_t bytesRead{ 0 };
+	size_t bytesWritten{ 0 };
+	size_t contestants{ 0 };		//contestants handled over all runs
+	size_t allocations{ 0 };		//heap allocations made (by any thread) while the stage ran
+	size_t peakResidentBytes{ 0 };	//peak resident set size of the process when the stage last finished
+
+	//throughput of 'bytes' moved over the stage's wall time, in MB/s (0 for a stage too quick to time)
+	double megabytesPerSecond(size_t bytes) const { return seconds > 0.0 ? static_cast<double>(bytes) / (1024.0 * 1024.0) / seconds : 0.0; }
+};
+
+/* Per-stage wall time, throughput and memory figures for '--stats' and '--stats-json' :
+   stages are timed by 'StageTimer' objects and added up by name, so a stage that runs once per batch or per quiz shows its totals.
+   while collection is off every timer returns straight away, without reading the clock or taking the lock */
+class PipelineStats
+{
+public:
+	void enable();										 //start collecting (and counting allocations); call before any other thread starts
+	bool isEnabled() const { return enabled; }
+	void record(const StageTotals& run);				 //add one run of a stage to that stage's totals
+	void printTable(ostream& out) const;				 //human-readable table, one row per stage in the order they first ran
+	void writeJson(ostream& out) const;					 //the same figures as one JSON object
+
+private:
+	bool enabled{ false };
+	mutable mutex lock;									 //'record' may be called from several threads (batch mode)
+	vector<StageTotals> stages{};
+};
+
+/* Scoped timer for one run of one stage : it starts when created and adds itself to the stage's totals when stopped or destroyed.
+   the code being timed reports its bytes and contestants through the 'add' calls, which cost nothing more than an addition */
+class StageTimer
+{
+public:
+	explicit StageTimer(const char* name);
+	~StageTimer() { stop(); }
+
+	StageTimer(const StageTimer&) = delete;
+	StageTimer& operator=(const StageTimer&) = delete;
+
+	void addBytesRead(size_t bytes) { run.bytesRead += bytes; }
+	void addBytesWritten(size_t bytes) { run.bytesWritten += bytes; }
+	void addContestants(size_t count) { run.contestants += count; }
+	void stop(); //record now instead of at the end of the scope (only the first call counts)
+
+private:
+	StageTotals run{};
+	bool running{ false };
+	chrono::steady_clock::time_point start{};
+	size_t startAllocations{ 0 };
+};
+
+//Process-wide instrumentation state: the stage totals, and the allocation counter kept by the replaced 'operator new'
+PipelineStats pipelineStats;
+bool countingAllocations{ false };
+atomic<size_t> allocationCount{ 0 };
+
+//Quiz files of a running '--benchmark' (none otherwise)
+BenchmarkTempFiles benchmarkTempFiles;
+
+//Signal handler for a '--benchmark' that is interrupted (Ctrl+C or a kill): remove its quiz files, then end the program as the signal would have
+void removeBenchmarkFilesOnSignal(int signalNumber)
+{
+	//only calls that are safe inside a signal handler: the names were set before the handler was installed
+#if defined(_WIN32)
+	remove(benchmarkTempFiles.answerKeyFilename.c_str());
+	remove(benchmarkTempFiles.contestantsFilename.c_str());
+#else
+	unlink(benchmarkTempFiles.answerKeyFilename.c_str());
+	unlink(benchmarkTempFiles.contestantsFilename.c_str());
+#endif
+	signal(signalNumber, SIG_DFL);
+	raise(signalNumber);
+}
+
+/* Read-only view of a whole file's contents :
+   on POSIX systems the file is memory-mapped, so parsing reads straight out of the page cache with no copy into a stream buffer.
+   elsewhere the file is read into one heap buffer with a single read call. The mapping (or buffer) is released by the destructor (RAII) */
+class MappedFile
+{
+public:
+	explicit MappedFile(const string& filename);
+	~MappedFile();
+
+	MappedFile(const MappedFile&) = delete;			   //a mapping has exactly one owner, so copying is not allowed
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	bool isOpen() const { return opened; }  //true if the file was found and its contents are available
+	const char* begin() const { return data; }
+	const char* end() const { return data + size; }
+	size_t sizeInBytes() const { return size; }
+
+private:
+	const char* data{ nullptr };	   //first byte of the file contents
+	size_t size{ 0 };				   //number of bytes in the file
+	bool opened{ false };			   //whether the file could be opened
+	unique_ptr<char[]> fallbackBuffer{}; //owns the contents when the file is read instead of mapped
+};
+
+/* Reads a contestant file in fixed-size batches, for files too large to hold in memory :
+   the file is read through one fixed-size buffer, and each batch is parsed into a caller-owned contestant table and answer matrix
+   that are reused for every batch, so memory use does not grow with the size of the file.
+   every contestant must be on their own line (as in the contestant file format) */
+class ContestantBatchReader
+{
+public:
+	ContestantBatchReader(const string& filename, size_t numQuestions, char blankAnswer);
+
+	bool isOpen() const { return static_cast<bool>(file); }
+	//read up to 'batchSize' contestants into the first rows of 'contestants' and 'answerMatrix'; returns how many were read (0 at end of file)
+	size_t readBatch(unique_ptr<Contestant[]>& contestants, AnswerMatrix& answerMatrix, size_t batchSize);
+	size_t bytesRead() const { return totalBytesRead; }
+
+private:
+	bool fillBuffer(); //move unparsed bytes to the front of the buffer and read more after them; false once the file is exhausted
+
+	ifstream file;							  //contestant file (binary mode: we do our own line handling)
+	size_t numQuestions{ 0 };				  //answers per contestant
+	char blankAnswer{ defaultBlankAnswer };	  //fills in the answers missing from a short line
+	size_t bufferSize{ 4 * 1024 * 1024 };	  //buffer capacity in bytes (doubled if a single line is ever longer)
+	unique_ptr<char[]> buffer{};			  //read buffer
+	size_t dataBegin{ 0 };					  //first unparsed byte in the buffer
+	size_t dataEnd{ 0 };					  //one past the last byte read into the buffer
+	bool endOfFile{ false };				  //true once the whole file has been read into the buffer at least once
+	size_t totalBytesRead{ 0 };				  //bytes read from the file so far
+};
+
+/* Scores kept up to date while contestants are appended to the contestant file ('--watch') :
+   every contestant's answers and correct-answer count are kept, so a corrected answer key entry only needs one question's column
+   rescanned; mean, median and mode come from the score histogram, which is adjusted in place. all members are guarded by 'lock' */
+class LiveScoreboard
+{
+public:
+	LiveScoreboard(const unique_ptr<char[]>& correctAnswers, size_t numQuestions, ReportWriter* writer);
+
+	void appendContestants(const char* begin, const char* end); //parse, score and add every contestant line in [begin, end)
+	bool correctAnswerKey(size_t question, char answer);		 //change one answer key entry (question counted from 0); false if out of range
+	void printSummary(const vector<double>& percentiles);		 //print the current summary to the console
+
+	mutex lock; //held by the tailing thread while appending and by the command thread while answering
+
+private:
+	size_t numQuestions{ 0 };
+	unique_ptr<char[]> correctAnswers{};					 //current answer key
+	unique_ptr<char[], AlignedDeleter<char>> paddedKey{};	 //answer key padded like an answer row, for the scoring kernel
+	RowScoringKernel scoreRow{ nullptr };					 //widest kernel this CPU supports
+	unique_ptr<Contestant[]> contestants{};					 //every contestant seen so far
+	AnswerMatrix answerMatrix{};							 //their answers
+	unique_ptr<size_t[]> correctCounts{};					 //their current number of correct answers
+	size_t numContestants{ 0 };
+	size_t capacity{ 0 };									 //rows allocated in 'contestants', 'answerMatrix' and 'correctCounts'
+	unique_ptr<size_t[]> scoreHistogram{};					 //contestants per number of correct answers
+	unique_ptr<size_t[]> missedQuestionsCounter{};			 //contestants who missed each question
+	unique_ptr<uint64_t[]> wrongMask{};						 //scratch wrong-question mask for the contestant being scored
+	ReportWriter* writer{ nullptr };						 //where new contestants' reports go (none if null)
+};
+
+/* Fixed set of worker threads shared by every quiz of a batch run ('--batch') :
+   tasks wait in one queue and each is run by the next free worker, which passes in its own index
+   so the task can use that worker's reusable buffers */
+class ThreadPool
+{
+public:
+	explicit ThreadPool(size_t numThreads);
+	~ThreadPool(); //finish the queued tasks, then stop and join the workers
+
+	ThreadPool(const ThreadPool&) = delete;
+	ThreadPool& operator=(const ThreadPool&) = delete;
+
+	void submit(function<void(size_t)> task); //queue 'task(workerIndex)'
+	void wait();							   //block until every submitted task has finished
+	size_t size() const { return workers.size(); }
+
+private:
+	void runWorker(size_t workerIndex);
+
+	vector<thread> workers{};
+	deque<function<void(size_t)>> tasks{};	//submitted tasks not yet started
+	size_t unfinishedTasks{ 0 };			//submitted tasks not yet finished
+	bool stopping{ false };					//set by the destructor once no more tasks will come
+	mutex lock;								//guards 'tasks', 'unfinishedTasks' and 'stopping'
+	condition_variable taskQueued;			//signalled when a task is queued or the pool is stopping
+	condition_variable allTasksDone;		//signalled when 'unfinishedTasks' drops to zero
+};
+
+//One line of a batch manifest: the files of one quiz and where its reports and summary go
+struct QuizJob
+{
+	string answerKeyFilename{};
+	string contestantsFilename{};
+	string outputFilename{};
+};
+
+//What happened to one quiz of a batch run, for the timing report
+struct QuizOutcome
+{
+	string error{};				  //empty if the quiz was scored and written
+	size_t numQuestions{ 0 };
+	size_t numContestants{ 0 };
+	size_t bytesRead{ 0 };		  //answer key plus contestant file
+	size_t bytesWritten{ 0 };	  //reports (the summary is not counted)
+	size_t worker{ 0 };			  //pool worker that ran the quiz
+	double loadSeconds{ 0.0 };	  //mapping and parsing both files
+	double scoreSeconds{ 0.0 };	  //scoring pass
+	double writeSeconds{ 0.0 };	  //reports and summary
+};
+
+/* One pool worker's buffers, kept from one quiz to the next so a batch run stops allocating once it has seen its largest quiz :
+   the contestant table, the answer matrix and the report writer's output buffer */
+struct QuizWorkspace
+{
+	unique_ptr<Contestant[]> contestants{};
+	size_t capacity{ 0 };			//rows allocated in 'contestants' and 'answerMatrix'
+	AnswerMatrix answerMatrix{};
+	ofstream reportFile{};			//declared before 'writer' so the writer is destroyed (and flushed) first
+	unique_ptr<ReportWriter> writer{};
+};
+
+//One batch of contestants in a pipelined run ('--pipeline'): read, scored and reported in turn, then reused for a later batch
+struct PipelineBatch
+{
+	size_t sequence{ 0 };				  //position of the batch in the contestant file, so reports are written in input order
+	size_t numContestants{ 0 };
+	size_t bytesRead{ 0 };				  //contestant file bytes read for this batch
+	unique_ptr<Contestant[]> contestants{}; //'batchSize' rows each
+	AnswerMatrix answerMatrix{};
+	ScoringResults results{};			  //'batchSize' rows, filled by the scoring worker (allocated with the batch and reused)
+};
+
+/* Bounded blocking queue of batches between two stages of a pipelined run :
+   a full queue makes its producer wait (backpressure, so memory stays bounded) and an empty one makes its consumer wait.
+   both waits are timed, and the number of batches queued is integrated over time, for the occupancy readout */
+class BatchQueue
+{
+public:
+	BatchQueue(const char* name, size_t capacity);
+
+	BatchQueue(const BatchQueue&) = delete;
+	BatchQueue& operator=(const BatchQueue&) = delete;
+
+	void push(PipelineBatch* batch); //wait for room, then queue 'batch'
+	PipelineBatch* pop();			 //wait for a batch; nullptr once the queue is closed and empty
+	PipelineBatch* tryPop();		 //a batch if one is queued, otherwise nullptr straight away
+	void close();					 //no more batches will be pushed; wakes every waiting consumer
+	void printOccupancy(ostream& out, double wallSeconds) const; //one readout row
+
+private:
+	void recordOccupancy(); //add the time since the last change at the current size (lock held)
+
+	const char* name{ nullptr };
+	size_t capacity{ 0 };
+	deque<PipelineBatch*> batches{};
+	bool closed{ false };
+	mutable mutex lock;					   //guards every member below 'capacity'
+	condition_variable notFull;			   //signalled when a batch is taken
+	condition_variable notEmpty;		   //signalled when a batch is queued or the queue is closed
+	chrono::steady_clock::time_point lastChange{ chrono::steady_clock::now() };
+	double batchSeconds{ 0.0 };			   //batches queued, integrated over time (divided by the run time, the mean occupancy)
+	size_t maxOccupancy{ 0 };
+	size_t fullWaits{ 0 };				   //pushes that found the queue full
+	size_t emptyWaits{ 0 };				   //pops that found the queue empty
+	double producerWaitSeconds{ 0.0 };
+	double consumerWaitSeconds{ 0.0 };
 };
 
 //Function forward declarations so our functions are known before they are called
 
+//Command line
+ProgramOptions parseCommandLine(int argc, char* argv[]);
+void exitWithUsage(const char* programName);
 //Data(file) processing
-unique_ptr<char[]> processAnswerKey(const string& answerKeyFilename, size_t& numQuestions);
-unique_ptr<Contestant[]> processContestantFile(const string& contestantsFilename, const size_t numQuestions, size_t& numContestants);
+unique_ptr<char[]> processAnswerKey(const string& answerKeyFilename, size_t& numQuestions, size_t& bytesRead);
+unique_ptr<char[]> parseAnswerKey(const char* begin, const char* end, size_t& numQuestions);
+unique_ptr<Contestant[]> processContestantFile(const string& contestantsFilename, const size_t numQuestions, char blankAnswer, size_t& numContestants, AnswerMatrix& answerMatrix, size_t& bytesRead);
+size_t parseContestantText(const char* begin, const char* end, size_t numQuestions, char blankAnswer, unique_ptr<Contestant[]>& contestants, size_t& capacity, AnswerMatrix& answerMatrix);
+void parseContestant(const char*& cursor, const char* end, size_t numQuestions, char blankAnswer, Contestant& contestant, char* answerRow);
+void streamContestantFile(const ProgramOptions& options, const unique_ptr<char[]>& correctAnswers, size_t numQuestions, const ScoringScheme& scheme);
+void pipelineContestantFile(const ProgramOptions& options, const unique_ptr<char[]>& correctAnswers, size_t numQuestions, const ScoringScheme& scheme);
+void addBatchTotals(const ScoringResults& results, size_t numQuestions, unique_ptr<size_t[]>& scoreHistogram, unique_ptr<size_t[]>& missedQuestionsCounter, ItemCounts* items);
+//Packed contestant files
+bool isPackedContestantFile(const string& filename);
+void compileContestantFile(const string& outputFilename, const unique_ptr<Contestant[]>& contestants, const AnswerMatrix& answerMatrix, size_t numContestants, size_t numQuestions);
+PackedContestants openPackedContestants(const MappedFile& file, size_t numQuestions);
+ScoringResults scorePackedContestants(const PackedContestants& packed, const unique_ptr<char[]>& correctAnswers, size_t numQuestions, size_t numThreads, const ScoringScheme& scheme);
+void scorePackedContestantFile(const ProgramOptions& options, const unique_ptr<char[]>& correctAnswers, size_t numQuestions, const ScoringScheme& scheme);
+//Live scoring
+void tailContestantFile(const string& filename, LiveScoreboard& scoreboard, size_t pollMilliseconds, const atomic<bool>& stopping);
+void runLiveScoring(const ProgramOptions& options, const unique_ptr<char[]>& correctAnswers, size_t numQuestions);
+//Batch runs
+vector<QuizJob> readQuizManifest(const string& manifestFilename);
+QuizOutcome scoreQuiz(const QuizJob& job, const ProgramOptions& options, QuizWorkspace& workspace);
+bool runQuizBatch(const ProgramOptions& options);
+//Synthetic quizzes and benchmarks
+const char* answerProfileName(AnswerProfile profile);
+size_t generateQuizFiles(const ProgramOptions& options, const string& answerKeyFilename, const string& contestantsFilename);
+void runBenchmarks(const ProgramOptions& options);
+//Answer storage
+unique_ptr<char[], AlignedDeleter<char>> allocateAlignedRows(size_t numRows, size_t rowStride);
+size_t paddedRowStride(size_t numQuestions);
+void growAnswerMatrix(AnswerMatrix& answerMatrix, size_t numContestants, size_t newCapacity);
 //Core logic
-unique_ptr<double[]> calculateContestantScores(const unique_ptr<Contestant[]>& contestants, size_t numContestants, const unique_ptr<char[]>& correctAnswers, size_t numQuestions);
-double calculateMean(const unique_ptr<double[]>& allScores, size_t numContestants);
-double calculateMedian(const unique_ptr<double[]>& sortedScores, size_t numContestants);
-vector<double> calculateModes(const unique_ptr<double[]>& sortedScores, size_t numContestants);
-unique_ptr<double[]> sortScoresArray(const unique_ptr<double[]>& allScores, size_t numContestants);
-unique_ptr<size_t[]> findMostMissedQuestions(const unique_ptr<Contestant[]>& contestants, size_t numContestants, const unique_ptr<char[]>& correctAnswers, size_t numQuestions);
+ScoringResults calculateContestantScores(const AnswerMatrix& answerMatrix, size_t numContestants, const unique_ptr<char[]>& correctAnswers, size_t numQuestions, size_t numThreads, bool analyseItems, const ScoringScheme& scheme);
+ScoringResults scoreAnswerRows(const AnswerMatrix& answerMatrix, size_t numRows, const unique_ptr<char[]>& correctAnswers, size_t numQuestions, size_t numThreads, bool analyseItems, const ScoringScheme& scheme, const size_t* rowWeights);
+void scoreAnswerRowsInto(ScoringResults& results, const AnswerMatrix& answerMatrix, size_t numRows, const unique_ptr<char[]>& correctAnswers, size_t numQuestions, size_t numThreads, const ScoringScheme& scheme, const size_t* rowWeights);
+ItemCounts allocateItemCounts(size_t numQuestions);
+//Scoring schemes
+ScoreScale correctCountScale(size_t numQuestions);
+ScoringScheme plainScoringScheme(size_t numQuestions);
+ScoringScheme buildScoringScheme(const vector<int64_t>& correctMarks, const vector<int64_t>& wrongMarks, char blankAnswer, size_t numQuestions, string& error);
+ScoringScheme loadScoringScheme(const string& answerKeyFilename, size_t numQuestions, string& error);
+const char* scoringPolicyName(ScoringPolicy policy);
+//Statistics (all computed from the score histogram, so nothing is copied or sorted)
+double scoreForCorrectCount(size_t correctAnswerCount, size_t numQuestions);
+double calculateMean(const unique_ptr<size_t[]>& scoreHistogram, const ScoreScale& scale, size_t numContestants);
+size_t scoreLevelAtRank(const unique_ptr<size_t[]>& scoreHistogram, const ScoreScale& scale, size_t rank);
+double calculateMedian(const unique_ptr<size_t[]>& scoreHistogram, const ScoreScale& scale, size_t numContestants);
+vector<double> calculateModes(const unique_ptr<size_t[]>& scoreHistogram, const ScoreScale& scale);
+double calculatePercentile(const unique_ptr<size_t[]>& scoreHistogram, const ScoreScale& scale, size_t numContestants, double percentile);
+//Scoring kernels
+size_t scoreRowScalar(const char* row, const char* key, size_t rowStride, uint64_t* wrongMask);
+RowScoringKernel selectRowScoringKernel();
 //Output
-void printContestantReports(const unique_ptr<Contestant[]>& contestants, const unique_ptr<double[]>& allScores, size_t numContestants, const unique_ptr<char[]>& correctAnswers, size_t numQuestions);
-void printMean(const unique_ptr<double[]>& allScores, size_t numContestants);
-void printMedian(const unique_ptr<double[]>& sortedScores, size_t numContestants);
-void printModes(const vector<double>& modes);
-void printMostMissedQuestions(const unique_ptr<size_t[]> missedQuestionsCounter, size_t numContestants, size_t numQuestions);
+void printContestantReports(ReportWriter& writer, const unique_ptr<Contestant[]>& contestants, const AnswerMatrix& answerMatrix, const ScoringResults& results, size_t numContestants, const unique_ptr<char[]>& correctAnswers);
+ostream& openReportStream(const ProgramOptions& options, ofstream& reportFile);
+const char* reportFormatName(ReportFormat format);
+const char* reportStageName(ReportFormat format);
+void printMean(ostream& out, const unique_ptr<size_t[]>& scoreHistogram, const ScoreScale& scale, size_t numContestants);
+void printMedian(ostream& out, const unique_ptr<size_t[]>& scoreHistogram, const ScoreScale& scale, size_t numContestants);
+void printModes(ostream& out, const vector<double>& modes);
+void printPercentiles(ostream& out, const unique_ptr<size_t[]>& scoreHistogram, const ScoreScale& scale, size_t numContestants, const vector<double>& percentiles);
+void printMostMissedQuestions(ostream& out, const unique_ptr<size_t[]>& missedQuestionsCounter, size_t numContestants, size_t numQuestions);
+void printScalingTable(const AnswerMatrix& answerMatrix, size_t numContestants, const unique_ptr<char[]>& correctAnswers, size_t numQuestions, size_t maxThreads, const ScoringScheme& scheme);
+//Instrumentation
+size_t peakResidentBytes();
+void* allocateCounted(size_t size) noexcept;
+void* allocateAlignedCounted(size_t size, align_val_t alignment) noexcept;
+void freeAligned(void* memory) noexcept;
+void reportPipelineStats(const ProgramOptions& options);
+void writeItemReport(const string& filename, const ItemCounts& items, const unique_ptr<size_t[]>& scoreHistogram, const unique_ptr<char[]>& correctAnswers, size_t numQuestions, size_t numContestants);
+//Contestant index
+template <typename IdOf>
+BuiltContestantIndex buildContestantIndex(size_t numContestants, size_t numQuestions, const ScoringResults& results, IdOf idOf);
+ContestantIndex openContestantIndex(const char* data, size_t sizeInBytes);
+void checkContestantIndexContents(const ContestantIndex& index);
+void answerContestantQueries(const ContestantIndex& index, istream& in, ostream& out);
+void serveContestantIndex(const ProgramOptions& options, const BuiltContestantIndex& built);
+void queryContestantIndexFile(const ProgramOptions& options);
+//Sharded runs
+void findShardSlice(const char* begin, const char* end, size_t shardIndex, size_t shardCount, const char*& sliceBegin, const char*& sliceEnd);
+uint64_t quizFingerprint(const unique_ptr<char[]>& correctAnswers, size_t numQuestions, const ScoringScheme& scheme);
+void scoreContestantShard(const ProgramOptions& options, const unique_ptr<char[]>& correctAnswers, size_t numQuestions, const ScoringScheme& scheme);
+void mergePartialSummaries(const ProgramOptions& options);
+//Deduplicated scoring
+AnswerPatterns findAnswerPatterns(const AnswerMatrix& answerMatrix, size_t numContestants, size_t numQuestions);
+void printPatternReports(ReportWriter& writer, const unique_ptr<Contestant[]>& contestants, const AnswerPatterns& patterns, const ScoringResults& results, size_t numContestants, const unique_ptr<char[]>& correctAnswers);
+void writeDuplicateClusters(const string& filename, const unique_ptr<Contestant[]>& contestants, const AnswerPatterns& patterns, const ScoringResults& results, size_t numContestants);
+void scoreDeduplicatedContestants(const ProgramOptions& options, const unique_ptr<Contestant[]>& contestants, const AnswerMatrix& answerMatrix, size_t numContestants, const unique_ptr<char[]>& correctAnswers, size_t numQuestions, const ScoringScheme& scheme);
 //Report summary
-void createReportSummary(const unique_ptr<double[]>& allScores, size_t numContestants, const unique_ptr<Contestant[]>& contestants, const unique_ptr<char[]>& correctAnswers, size_t numQuestions, const unique_ptr<double[]>& sortedScores, const vector<double>& modes);
+void createReportSummary(ostream& out, const unique_ptr<size_t[]>& scoreHistogram, const ScoreScale& scale, size_t numContestants, const unique_ptr<size_t[]>& missedQuestionsCounter, size_t numQuestions, const vector<double>& percentiles);
 
-int main()
+int main(int argc, char* argv[])
 {
-	string answerKeyFilename{};		//create string variable to store answer key filename
-	string contestantsFilename{};   //create string variable to store contestant responses file name
+	//read options (and optionally the two file names) from the command line
+	ProgramOptions options = parseCommandLine(argc, argv);
+
+	//with '--stats' or '--stats-json', every stage below is timed; the figures are reported however main returns
+	if (options.showStats || !options.statsJsonFilename.empty())
+	{
+		pipelineStats.enable();
+	}
+	struct StatsReportAtExit
+	{
+		const ProgramOptions& options;
+		~StatsReportAtExit() { reportPipelineStats(options); }
+	} statsReportAtExit{ options };
+
+	//in batch mode every quiz listed in the manifest is scored, each into its own output file
+	if (!options.manifestFilename.empty())
+	{
+		return runQuizBatch(options) ? 0 : 1;
+	}
+
+	//'--merge' prints the summary of a sharded run from the shards' partial summaries; nothing is loaded or scored
+	if (options.mergePartials)
+	{
+		mergePartialSummaries(options);
+		return 0;
+	}
+
+	//'--index' answers queries from a saved contestant index; nothing is loaded or scored
+	if (!options.indexFilename.empty())
+	{
+		queryContestantIndexFile(options);
+		return 0;
+	}
+
+	//'--generate' writes a synthetic quiz to the two file names given; '--benchmark' times every stage on synthetic quizzes
+	if (options.generateQuiz)
+	{
+		generateQuizFiles(options, options.answerKeyFilename, options.contestantsFilename);
+		return 0;
+	}
+	if (options.runBenchmarks)
+	{
+		runBenchmarks(options);
+		return 0;
+	}
 
 	//prompt user to enter name of answer key file, and store it in 'answerKeyFilename' variable
-	cout << "Enter answer file name: ";
-	cin >> answerKeyFilename;
-	cout << '\n';
+	if (options.answerKeyFilename.empty())
+	{
+		cout << "Enter answer file name: ";
+		cin >> options.answerKeyFilename;
+		cout << '\n';
+	}
 
 	//prompt user to enter name of the contestant responses file, and store it in 'contestantsFilename' variable
-	cout << "Enter contestant file name: ";
-	cin >> contestantsFilename;
+	if (options.contestantsFilename.empty())
+	{
+		cout << "Enter contestant file name: ";
+		cin >> options.contestantsFilename;
+	}
 
 	size_t numQuestions{ 0 };   //variable to keep track of number of questions in quiz - will be modified by 'processAnswerKey'
 	size_t numContestants{ 0 }; //variable to keep track of number of contestants - will be modified by 'processContestantFile'
+	size_t answerKeyBytes{ 0 };   //size of answer key file - will be modified by 'processAnswerKey'
+	AnswerMatrix answerMatrix{};  //every contestant's answers, one padded row each - filled by 'processContestantFile'
+	size_t contestantBytes{ 0 };  //size of contestant file - will be modified by 'processContestantFile'
 
 	//Call 'processAnswerKey' function to read the correct answers from the file:
 	//create smart pointer for dynamic array and initialize with returned dynamic array of correct answers from function call
 	//also modifies 'numQuestions' to reflect actual count
-	unique_ptr<char[]> correctAnswers = processAnswerKey(answerKeyFilename, numQuestions);
+	StageTimer answerKeyTimer("load answer key");
+	unique_ptr<char[]> correctAnswers = processAnswerKey(options.answerKeyFilename, numQuestions, answerKeyBytes);
+	//a scheme file next to the answer key ('<answer key>.scheme') can weight questions and take marks off for wrong answers
+	string schemeError{};
+	ScoringScheme scheme = loadScoringScheme(options.answerKeyFilename, numQuestions, schemeError);
+	if (!schemeError.empty())
+	{
+		cerr << schemeError << ".\n"; //print an error to the console
+		exit(1); //and exit the program
+	}
+	answerKeyTimer.addBytesRead(answerKeyBytes);
+	answerKeyTimer.stop();
+
+	//live scoring, item analysis and the contestant index all rank contestants by number of correct answers
+	if (scheme.policy != ScoringPolicy::Plain && (options.watchContestants || !options.itemReportFilename.empty() || options.queryContestants || !options.saveIndexFilename.empty()))
+	{
+		cerr << "a " << scoringPolicyName(scheme.policy) << " scoring scheme cannot be used with --watch, --items, --query or --save-index.\n";
+		exit(1);
+	}
+
+	//in live mode the contestant file is tailed and scored as it grows, until 'quit' is received
+	if (options.watchContestants)
+	{
+		runLiveScoring(options, correctAnswers, numQuestions);
+		return 0;
+	}
+
+	//with '--partial', score one shard of the contestant file ('--shard K/N') and write its partial summary for '--merge'
+	if (!options.partialFilename.empty())
+	{
+		scoreContestantShard(options, correctAnswers, numQuestions, scheme);
+		return 0;
+	}
+
+	//a packed contestant file (from '--compile') is scored straight from its memory-mapped packed rows
+	if (isPackedContestantFile(options.contestantsFilename))
+	{
+		if (options.dedupAnswers || !options.compileFilename.empty())
+		{
+			cerr << (options.dedupAnswers ? "--dedup" : "--compile") << " works on text contestant files only.\n";
+			exit(1);
+		}
+		scorePackedContestantFile(options, correctAnswers, numQuestions, scheme);
+		return 0;
+	}
+
+	//in streaming mode the contestant file is read, scored and reported batch by batch instead of being loaded here
+	if (options.streamContestants)
+	{
+		streamContestantFile(options, correctAnswers, numQuestions, scheme);
+		return 0;
+	}
+
+	//in pipelined mode a reader thread, scoring workers and a writer work on different batches at the same time
+	if (options.pipelineContestants)
+	{
+		pipelineContestantFile(options, correctAnswers, numQuestions, scheme);
+		return 0;
+	}
 
 	//Call 'processContestantFile' function to read the contestants' info from the file:
 	//create smart pointer for dynamic array and initialize with returned dynamic array of 'Contestant' objects from function call
 	//also modifies 'numContestants' to reflect actual count
-	unique_ptr<Contestant[]> contestants = processContestantFile(contestantsFilename, numQuestions, numContestants);
+	StageTimer contestantTimer("load contestants");
+	unique_ptr<Contestant[]> contestants = processContestantFile(options.contestantsFilename, numQuestions, scheme.blankAnswer, numContestants, answerMatrix, contestantBytes);
+	contestantTimer.addBytesRead(contestantBytes);
+	contestantTimer.addContestants(numContestants);
+	contestantTimer.stop();
+
+	//with '--compile', just write the contestants out in packed form
+	if (!options.compileFilename.empty())
+	{
+		compileContestantFile(options.compileFilename, contestants, answerMatrix, numContestants, numQuestions);
+		return 0;
+	}
+
+	//with '--dedup', identical answer rows are scored and reported once and the results shared by every contestant who gave them
+	if (options.dedupAnswers)
+	{
+		scoreDeduplicatedContestants(options, contestants, answerMatrix, numContestants, correctAnswers, numQuestions, scheme);
+		return 0;
+	}
+
+	//Call 'calculateContestantScores' function to calcaulate scores for each contestant based on their answers:
+	//this single pass also counts misses per question and records which questions each contestant got wrong
+	//with '--threads N' the contestants are split across N threads; the results are the same for any thread count
+	StageTimer scoringTimer("score");
+	ScoringResults results = calculateContestantScores(answerMatrix, numContestants, correctAnswers, numQuestions, options.numThreads, !options.itemReportFilename.empty(), scheme);
+	scoringTimer.addContestants(numContestants);
+	scoringTimer.stop();
+
+	//if requested, time the scoring pass again for each thread count up to the one chosen
+	if (options.showScalingTable)
+	{
+		printScalingTable(answerMatrix, numContestants, correctAnswers, numQuestions, max<size_t>(options.numThreads, thread::hardware_concurrency()), scheme);
+	}
+
+	//Call 'printContestantReports' to print detailed report for each contestant (to the console or '--output' file, in the '--format' chosen)
+	ofstream reportFile{};
+	StageTimer reportTimer(reportStageName(options.reportFormat));
+	ReportWriter writer(openReportStream(options, reportFile), options.reportFormat, numQuestions);
+	printContestantReports(writer, contestants, answerMatrix, results, numContestants, correctAnswers);
+	writer.flush(); //reports must be out before the summary is printed
+	reportTimer.addBytesWritten(writer.bytesWritten());
+	reportTimer.addContestants(numContestants);
+	reportTimer.stop();
+
+	//call 'createReportSummary' to create and display summary report based on all contestants' scores:
+	//this includes calculating and displaying the mean, median, mode, and most missed questions, all from the score histogram
+	createReportSummary(cout, results.scoreHistogram, results.scale, numContestants, results.missedQuestionsCounter, numQuestions, options.percentiles);
+
+	//with '--items', write the item analysis gathered by the scoring pass
+	if (!options.itemReportFilename.empty())
+	{
+		StageTimer itemTimer("item report");
+		writeItemReport(options.itemReportFilename, results.items, results.scoreHistogram, correctAnswers, numQuestions, numContestants);
+	}
+
+	//with '--query' or '--save-index', index the contestants by id so any contestant's score, rank and percentile can be looked up directly
+	if (options.queryContestants || !options.saveIndexFilename.empty())
+	{
+		StageTimer indexTimer("build index");
+		BuiltContestantIndex index = buildContestantIndex(numContestants, numQuestions, results, [&](size_t i) { return string_view((contestants.get() + i)->id); });
+		indexTimer.addContestants(numContestants);
+		indexTimer.stop();
+		serveContestantIndex(options, index);
+	}
+
+	return 0; //return 0 to indicate successful completion of program
+}
+
+//Function to print how the program is run and exit with an error status
+void exitWithUsage(const char* programName)
+{
+	cerr << "usage: " << programName << " [options] [answerFile contestantFile]\n"
+		 << "  --stats          print time, throughput, allocations and peak memory of every stage to the error stream\n"
+		 << "  --stats-json F   write the same per-stage figures to file F as JSON\n"
+		 << "  --items FILE     also write an item analysis (option counts, p-values, point-biserials, discrimination) to FILE as CSV\n"
+		 << "  --threads N      score with N threads (0 = one per CPU core)\n"
+		 << "  --scaling        print a scoring time table for 1 to N threads to the error stream\n"
+		 << "  --percentile P   also print the P-th percentile of the scores (0-100, repeatable)\n"
+		 << "  --stream         process the contestant file in batches, with memory use independent of its size\n"
+		 << "  --batch-size N   contestants per batch with --stream or --pipeline (default 65536)\n"
+		 << "  --pipeline       read, score (on --threads workers) and report batches at the same time\n"
+		 << "  --queue-depth N  batches each --pipeline queue holds before backpressure (default 4)\n"
+		 << "  --format F       contestant report format: text (default), csv, json (JSON Lines) or binary\n"
+		 << "  --output FILE    write contestant reports to FILE instead of the console (the summary stays on the console)\n"
+		 << "  --compile FILE   convert the contestant file to the packed binary format in FILE and exit\n"
+		 << "  --query          after the run, answer contestant ids from standard input with score, rank, percentile and wrong questions\n"
+		 << "  --save-index F   write the contestant index (ids, scores, ranks, wrong questions) to file F\n"
+		 << "  --index FILE     answer contestant ids from standard input with a saved index file, then exit\n"
+		 << "  --shard K/N      score only the K-th of N slices of the contestant file (needs --partial)\n"
+		 << "  --partial FILE   write this run's partial summary to FILE for --merge, instead of printing a summary\n"
+		 << "  --merge          print the summary of the partial summary files given in place of answerFile and contestantFile\n"
+		 << "  --dedup          score and report each distinct answer row once; print the deduplication ratio\n"
+		 << "  --clusters FILE  with --dedup, write each group of contestants with identical answers to FILE as CSV\n"
+		 << "  --watch          keep scoring contestants appended to the contestant file; read commands from standard input\n"
+		 << "  --poll-ms N      how often --watch checks for new contestants (default 500)\n"
+		 << "  --batch FILE     score every 'answerFile contestantFile outputFile' line of FILE on a pool of --threads workers\n"
+		 << "  --generate       write a synthetic quiz to answerFile and contestantFile, then exit\n"
+		 << "  --benchmark      time every stage on synthetic quizzes of 1000 up to --bench-max contestants (JSON Lines)\n"
+		 << "  --contestants N  contestants in a generated quiz (default 1000)\n"
+		 << "  --questions N    questions in a generated or benchmark quiz (default 50)\n"
+		 << "  --alphabet CHARS answer options of generated quizzes (default ABCD)\n"
+		 << "  --profile P      generated answers: uniform, ability (default) or clustered\n"
+		 << "  --seed N         random seed of generated quizzes (default 1)\n"
+		 << "  --bench-max N    largest benchmark quiz (default 1000000)\n";
+	exit(1);
+}
+
+//Helper to read the number following an option such as '--threads', exiting with usage if it is missing or not a number
+size_t readCountOption(int argc, char* argv[], int& i)
+{
+	if (i + 1 >= argc)
+	{
+		cerr << "option '" << argv[i] << "' needs a value\n";
+		exitWithUsage(argv[0]);
+	}
+	++i;
+	char* parsedEnd = nullptr;
+	unsigned long long value = strtoull(argv[i], &parsedEnd, 10);
+	if (parsedEnd == argv[i] || *parsedEnd != '\0')
+	{
+		cerr << "'" << argv[i] << "' is not a number\n";
+		exitWithUsage(argv[0]);
+	}
+	return static_cast<size_t>(value);
+}
+
+//Helper to read the percentile following '--percentile', exiting with usage if it is missing or outside 0-100
+double readPercentileOption(int argc, char* argv[], int& i)
+{
+	if (i + 1 >= argc)
+	{
+		cerr << "option '" << argv[i] << "' needs a value\n";
+		exitWithUsage(argv[0]);
+	}
+	++i;
+	char* parsedEnd = nullptr;
+	double value = strtod(argv[i], &parsedEnd);
+	if (parsedEnd == argv[i] || *parsedEnd != '\0' || value < 0.0 || value > 100.0)
+	{
+		cerr << "'" << argv[i] << "' is not a percentile between 0 and 100\n";
+		exitWithUsage(argv[0]);
+	}
+	return value;
+}
+
+//Function to read the command line: '[options] [answerFile contestantFile]'
+ProgramOptions parseCommandLine(int argc, char* argv[])
+{
+	ProgramOptions options{};
+	vector<string> filenames; //positional arguments, in the order given
+
+	for (int i = 1; i < argc; ++i)
+	{
+		string argument(argv[i]);
+		if (argument == "--stats")
+		{
+			options.showStats = true;
+		}
+		else if (argument == "--threads")
+		{
+			options.numThreads = readCountOption(argc, argv, i);
+			if (options.numThreads == 0) //0 means use every core
+			{
+				options.numThreads = max<size_t>(thread::hardware_concurrency(), 1);
+			}
+		}
+		else if (argument == "--scaling")
+		{
+			options.showScalingTable = true;
+		}
+		else if (argument == "--stream")
+		{
+			options.streamContestants = true;
+		}
+		else if (argument == "--batch-size")
+		{
+			options.batchSize = readCountOption(argc, argv, i);
+		}
+		else if (argument == "--pipeline")
+		{
+			options.pipelineContestants = true;
+		}
+		else if (argument == "--queue-depth")
+		{
+			options.queueDepth = max<size_t>(readCountOption(argc, argv, i), 1);
+		}
+		else if (argument == "--format")
+		{
+			string formatName{ (i + 1 < argc) ? argv[++i] : "" };
+			if (formatName == "text")
+			{
+				options.reportFormat = ReportFormat::Text;
+			}
+			else if (formatName == "csv")
+			{
+				options.reportFormat = ReportFormat::Csv;
+			}
+			else if (formatName == "json")
+			{
+				options.reportFormat = ReportFormat::JsonLines;
+			}
+			else if (formatName == "binary")
+			{
+				options.reportFormat = ReportFormat::Binary;
+			}
+			else
+			{
+				cerr << "unknown report format '" << formatName << "'\n";
+				exitWithUsage(argv[0]);
+			}
+		}
+		else if (argument == "--output" || argument == "--compile" || argument == "--batch" || argument == "--stats-json" || argument == "--items"
+			|| argument == "--save-index" || argument == "--index" || argument == "--partial" || argument == "--clusters")
+		{
+			if (i + 1 >= argc)
+			{
+				cerr << "option '" << argument << "' needs a value\n";
+				exitWithUsage(argv[0]);
+			}
+			(argument == "--output" ? options.reportFilename : argument == "--compile" ? options.compileFilename
+				: argument == "--batch" ? options.manifestFilename : argument == "--stats-json" ? options.statsJsonFilename
+				: argument == "--items" ? options.itemReportFilename : argument == "--save-index" ? options.saveIndexFilename
+				: argument == "--index" ? options.indexFilename : argument == "--partial" ? options.partialFilename : options.clustersFilename) = argv[++i];
+		}
+		else if (argument == "--shard")
+		{
+			//'K/N', with 1 <= K <= N
+			string shard{ (i + 1 < argc) ? argv[++i] : "" };
+			char* parsedEnd = nullptr;
+			options.shardIndex = static_cast<size_t>(strtoull(shard.c_str(), &parsedEnd, 10));
+			bool valid{ parsedEnd != shard.c_str() && *parsedEnd == '/' };
+			const char* countBegin = valid ? parsedEnd + 1 : shard.c_str();
+			options.shardCount = static_cast<size_t>(strtoull(countBegin, &parsedEnd, 10));
+			valid = valid && parsedEnd != countBegin && *parsedEnd == '\0' && options.shardIndex >= 1 && options.shardIndex <= options.shardCount && options.shardCount <= 0xFFFFFFFFu;
+			if (!valid)
+			{
+				cerr << "'" << shard << "' is not a shard K/N\n";
+				exitWithUsage(argv[0]);
+			}
+		}
+		else if (argument == "--merge")
+		{
+			options.mergePartials = true;
+		}
+		else if (argument == "--dedup")
+		{
+			options.dedupAnswers = true;
+		}
+		else if (argument == "--query")
+		{
+			options.queryContestants = true;
+		}
+		else if (argument == "--watch")
+		{
+			options.watchContestants = true;
+		}
+		else if (argument == "--poll-ms")
+		{
+			options.pollMilliseconds = readCountOption(argc, argv, i);
+		}
+		else if (argument == "--generate" || argument == "--benchmark")
+		{
+			(argument == "--generate" ? options.generateQuiz : options.runBenchmarks) = true;
+		}
+		else if (argument == "--contestants")
+		{
+			options.generateContestants = readCountOption(argc, argv, i);
+		}
+		else if (argument == "--questions")
+		{
+			options.generateQuestions = max<size_t>(readCountOption(argc, argv, i), 1);
+		}
+		else if (argument == "--bench-max")
+		{
+			options.benchmarkMaxContestants = readCountOption(argc, argv, i);
+		}
+		else if (argument == "--seed")
+		{
+			options.seed = readCountOption(argc, argv, i);
+		}
+		else if (argument == "--alphabet")
+		{
+			options.alphabet = (i + 1 < argc) ? argv[++i] : "";
+			//options must be distinct single characters that the contestant file format can hold
+			bool valid{ !options.alphabet.empty() && options.alphabet.size() <= 64 };
+			for (size_t k = 0; k < options.alphabet.size(); ++k)
+			{
+				valid = valid && !isspace(static_cast<unsigned char>(options.alphabet[k])) && options.alphabet.find(options.alphabet[k]) == k;
+			}
+			if (!valid)
+			{
+				cerr << "'" << options.alphabet << "' is not a list of distinct answer options\n";
+				exitWithUsage(argv[0]);
+			}
+		}
+		else if (argument == "--profile")
+		{
+			string profileName{ (i + 1 < argc) ? argv[++i] : "" };
+			if (profileName == "uniform")
+			{
+				options.answerProfile = AnswerProfile::Uniform;
+			}
+			else if (profileName == "ability")
+			{
+				options.answerProfile = AnswerProfile::Ability;
+			}
+			else if (profileName == "clustered")
+			{
+				options.answerProfile = AnswerProfile::Clustered;
+			}
+			else
+			{
+				cerr << "unknown answer profile '" << profileName << "'\n";
+				exitWithUsage(argv[0]);
+			}
+		}
+		else if (argument == "--percentile")
+		{
+			options.percentiles.push_back(readPercentileOption(argc, argv, i));
+		}
+		else if (argument.size() > 1 && argument[0] == '-')
+		{
+			cerr << "unknown option '" << argument << "'\n";
+			exitWithUsage(argv[0]);
+		}
+		else
+		{
+			filenames.push_back(argument);
+		}
+	}
+
+	//'--batch' takes its file names from the manifest, '--benchmark' makes its own, and '--index' needs none
+	if ((!options.manifestFilename.empty() || options.runBenchmarks || !options.indexFilename.empty()) && !filenames.empty())
+	{
+		exitWithUsage(argv[0]);
+	}
+
+	//item analysis covers one whole contestant file, loaded or streamed
+	if (!options.itemReportFilename.empty() && (options.watchContestants || !options.manifestFilename.empty()))
+	{
+		cerr << "--items cannot be combined with --watch or --batch\n";
+		exitWithUsage(argv[0]);
+	}
+
+	//'--compile' converts one loaded contestant file and exits, so it cannot take part in a run that scores contestants another way
+	if (!options.compileFilename.empty() && (options.streamContestants || options.pipelineContestants || options.watchContestants || !options.manifestFilename.empty()))
+	{
+		cerr << "--compile cannot be combined with --stream, --pipeline, --watch or --batch\n";
+		exitWithUsage(argv[0]);
+	}
+
+	//'--merge' takes partial summary files instead of the answer and contestant files
+	if (options.mergePartials)
+	{
+		if (filenames.empty())
+		{
+			exitWithUsage(argv[0]);
+		}
+		options.partialFilenames = filenames;
+		return options;
+	}
+
+	//a shard scores its slice in memory and writes a partial summary, and every shard's partial is needed for the summary
+	if (options.shardCount > 1 && options.partialFilename.empty())
+	{
+		cerr << "--shard needs --partial\n";
+		exitWithUsage(argv[0]);
+	}
+	if (!options.partialFilename.empty() && (options.streamContestants || options.watchContestants || !options.manifestFilename.empty() || !options.compileFilename.empty()
+		|| !options.itemReportFilename.empty() || options.queryContestants || !options.saveIndexFilename.empty() || options.generateQuiz || options.runBenchmarks))
+	{
+		cerr << "--partial cannot be combined with --stream, --watch, --batch, --compile, --items, --query, --save-index, --generate or --benchmark\n";
+		exitWithUsage(argv[0]);
+	}
+
+	//a pipelined run is a streamed run with its stages on separate threads
+	if (options.pipelineContestants && (options.streamContestants || options.watchContestants || !options.manifestFilename.empty() || !options.compileFilename.empty()
+		|| options.queryContestants || !options.saveIndexFilename.empty() || !options.partialFilename.empty()))
+	{
+		cerr << "--pipeline cannot be combined with --stream, --watch, --batch, --compile, --query, --save-index or --partial\n";
+		exitWithUsage(argv[0]);
+	}
+
+	//deduplication works on a whole loaded file, and its results are kept per answer pattern rather than per contestant
+	if (!options.clustersFilename.empty() && !options.dedupAnswers)
+	{
+		cerr << "--clusters needs --dedup\n";
+		exitWithUsage(argv[0]);
+	}
+	if (options.dedupAnswers && (options.streamContestants || options.pipelineContestants || options.watchContestants || !options.manifestFilename.empty() || !options.compileFilename.empty()
+		|| options.queryContestants || !options.saveIndexFilename.empty() || !options.partialFilename.empty() || options.showScalingTable))
+	{
+		cerr << "--dedup cannot be combined with --stream, --pipeline, --watch, --batch, --compile, --query, --save-index, --partial or --scaling\n";
+		exitWithUsage(argv[0]);
+	}
+
+	//the index holds every contestant of one scored file, so it is built from a loaded or packed file after a normal run
+	if ((options.queryContestants || !options.saveIndexFilename.empty())
+		&& (options.streamContestants || options.watchContestants || !options.manifestFilename.empty() || !options.compileFilename.empty()))
+	{
+		cerr << "--query and --save-index cannot be combined with --stream, --watch, --batch or --compile\n";
+		exitWithUsage(argv[0]);
+	}
+
+	//file names are either both given or both prompted for
+	if (filenames.size() == 2)
+	{
+		options.answerKeyFilename = filenames.at(0);
+		options.contestantsFilename = filenames.at(1);
+	}
+	else if (!filenames.empty() || options.watchContestants || options.generateQuiz || options.queryContestants) //'--watch' and '--query' use standard input, so they cannot prompt
+	{
+		exitWithUsage(argv[0]);
+	}
+	return options;
+}
+
+//Open a file and make its whole contents available as one contiguous block of memory
+MappedFile::MappedFile(const string& filename)
+{
+#if defined(_WIN32)
+	//no mmap here: read the file into a single heap buffer with one read call
+	ifstream file(filename, ios::in | ios::binary);
+	if (!file)
+	{
+		return;
+	}
+	struct _stat64 info {};
+	if (_stat64(filename.c_str(), &info) != 0)
+	{
+		return;
+	}
+	size = static_cast<size_t>(info.st_size);
+	fallbackBuffer = unique_ptr<char[]>(new char[size + 1]);
+	file.read(fallbackBuffer.get(), static_cast<streamsize>(size));
+	size = static_cast<size_t>(file.gcount());
+	data = fallbackBuffer.get();
+	opened = true;
+#else
+	int fd = open(filename.c_str(), O_RDONLY);
+	if (fd < 0)
+	{
+		return;
+	}
+	struct stat info {};
+	if (fstat(fd, &info) != 0)
+	{
+		close(fd);
+		return;
+	}
+	size = static_cast<size_t>(info.st_size);
+	opened = true;
+
+	if (size > 0) //mmap of an empty file fails, and there is nothing to read anyway
+	{
+		void* mapping = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (mapping == MAP_FAILED)
+		{
+			opened = false;
+			size = 0;
+		}
+		else
+		{
+			madvise(mapping, size, MADV_SEQUENTIAL); //we parse front to back, so ask the kernel to read ahead aggressively
+			data = static_cast<const char*>(mapping);
+		}
+	}
+	close(fd); //the mapping stays valid after the descriptor is closed
+#endif
+}
+
+//Release the mapping (the fallback buffer releases itself)
+MappedFile::~MappedFile()
+{
+#if !defined(_WIN32)
+	if (data != nullptr)
+	{
+		munmap(const_cast<char*>(data), size);
+	}
+#endif
+}
+
+//Helper to check for the same whitespace characters 'operator>>' skips over
+inline bool isWhitespace(char c)
+{
+	return c == ' ' || c == '\n' || c == '\r' || c == '\t' || c == '\v' || c == '\f';
+}
+
+//Helper to move 'cursor' forward past any whitespace, stopping at 'end'
+inline const char* skipWhitespace(const char* cursor, const char* end)
+{
+	while (cursor < end && isWhitespace(*cursor))
+	{
+		++cursor;
+	}
+	return cursor;
+}
+
+//Function to process the answer key file and store answers into dynamically allocated array
+unique_ptr<char[]> processAnswerKey(const string& answerKeyFilename, size_t& numQuestions, size_t& bytesRead)
+{
+	//map answer key file into memory (read-only)
+	MappedFile afile(answerKeyFilename);
+
+	if (!afile.isOpen()) //if answer key file cannot be successfully opened
+	{
+		cerr << "answer file could not be opened for reading.\n"; //print an error to the console 
+		exit(1); //and exit the program
+	}
+	bytesRead = afile.sizeInBytes();
+
+	unique_ptr<char[]> answers = parseAnswerKey(afile.begin(), afile.end(), numQuestions);
+	if (numQuestions == 0) //if answer key holds no answers, there is nothing to score against (every score would be 0 out of 0)
+	{
+		cerr << "answer file contains no answers.\n"; //print an error to the console
+		exit(1); //and exit the program
+	}
+	return answers; //return unique_ptr(smart pointer) managing dynamically allocated array of correct answers
+}
+
+//Function to read the correct answers (one non-whitespace character each) from the answer key text in [begin, end)
+unique_ptr<char[]> parseAnswerKey(const char* begin, const char* end, size_t& numQuestions)
+{
+	/* Allocate memory dynamically for storing correct answers :
+	   every answer takes at least one byte of the file, so the file size is an upper bound on the number of answers.
+	   this lets us read the answers in a single pass instead of counting them first and re-reading the file */
+	unique_ptr<char[]> answers(new char[static_cast<size_t>(end - begin) + 1]);
+
+	//read characters(correct answers) one by one until reaching the end, skipping whitespace between them
+	for (const char* cursor = skipWhitespace(begin, end); cursor < end; cursor = skipWhitespace(cursor + 1, end))
+	{
+		*(answers.get() + numQuestions) = *cursor; //store answer at next free position
+		++numQuestions;							   //each time a character(answer) is read in, increase our numQuestions counter by one
+	}
+	return answers;
+}
+
+//Helper to grow the contestant table to 'newCapacity' entries, moving the first 'numContestants' entries across
+void growContestantTable(unique_ptr<Contestant[]>& contestants, size_t numContestants, size_t newCapacity)
+{
+	unique_ptr<Contestant[]> grown(new Contestant[newCapacity]);
+	for (size_t i = 0; i < numContestants; ++i)
+	{
+		*(grown.get() + i) = move(*(contestants.get() + i)); //moving only transfers the id buffer, nothing is copied
+	}
+	contestants = move(grown);
+}
+
+//Function to allocate 'numRows' rows of 'rowStride' bytes in one cache-line-aligned block, with every byte set to zero
+unique_ptr<char[], AlignedDeleter<char>> allocateAlignedRows(size_t numRows, size_t rowStride)
+{
+	//zero padding never differs between a row and the answer key, so it always counts as a match
+	return allocateAligned<char>(numRows * rowStride);
+}
+
+//Function to find the row width for a quiz: the number of questions rounded up to a whole number of cache lines (at least one)
+size_t paddedRowStride(size_t numQuestions)
+{
+	size_t cacheLines{ (numQuestions + cacheLineSize - 1) / cacheLineSize };
+	return max<size_t>(cacheLines, 1) * cacheLineSize;
+}
+
+//Helper to grow the answer matrix to 'newCapacity' rows, copying the first 'numContestants' rows across in one block
+void growAnswerMatrix(AnswerMatrix& answerMatrix, size_t numContestants, size_t newCapacity)
+{
+	unique_ptr<char[], AlignedDeleter<char>> grown = allocateAlignedRows(newCapacity, answerMatrix.rowStride);
+	if (numContestants > 0)
+	{
+		memcpy(grown.get(), answerMatrix.data.get(), numContestants * answerMatrix.rowStride);
+	}
+	answerMatrix.data = move(grown);
+	answerMatrix.capacity = newCapacity;
+}
+
+//Helper to read one contestant (id, then one answer per question) from its line [cursor, end); leaves 'cursor' just past the last answer read.
+//answers missing from a short line are filled in with 'blankAnswer', so they count as left blank under every scoring scheme
+void parseContestant(const char*& cursor, const char* end, size_t numQuestions, char blankAnswer, Contestant& contestant, char* answerRow)
+{
+	//read and store contestant's id number (everything up to the next whitespace)
+	const char* idStart = cursor;
+	while (cursor < end && !isWhitespace(*cursor))
+	{
+		++cursor;
+	}
+	contestant.id.assign(idStart, static_cast<size_t>(cursor - idStart));
+
+	//read each answer for the contestant (one non-whitespace character each) straight into its row
+	for (size_t j = 0; j < numQuestions; ++j)
+	{
+		cursor = skipWhitespace(cursor, end);
+		//a short line leaves the remaining questions unanswered: they never match the answer key, and negative marking does not penalise them
+		//(every loader stops at the end of the line)
+		*(answerRow + j) = (cursor < end) ? *cursor++ : blankAnswer;
+	}
+}
+
+//Open the contestant file for batch reading
+ContestantBatchReader::ContestantBatchReader(const string& filename, size_t numQuestions, char blankAnswer)
+	: file(filename, ios::in | ios::binary), numQuestions(numQuestions), blankAnswer(blankAnswer), buffer(new char[bufferSize])
+{
+}
+
+//Move unparsed bytes to the front of the buffer and fill the rest from the file
+bool ContestantBatchReader::fillBuffer()
+{
+	if (endOfFile)
+	{
+		return false;
+	}
+	//keep the unparsed tail (a partial line) by moving it to the front
+	size_t remaining{ dataEnd - dataBegin };
+	if (remaining == bufferSize) //one line fills the whole buffer: make room by doubling it
+	{
+		unique_ptr<char[]> grown(new char[bufferSize * 2]);
+		memcpy(grown.get(), buffer.get() + dataBegin, remaining);
+		buffer = move(grown);
+		bufferSize *= 2;
+	}
+	else
+	{
+		memmove(buffer.get(), buffer.get() + dataBegin, remaining);
+	}
+	dataBegin = 0;
+	dataEnd = remaining;
+
+	//read as much as fits after it
+	file.read(buffer.get() + dataEnd, static_cast<streamsize>(bufferSize - dataEnd));
+	size_t received{ static_cast<size_t>(file.gcount()) };
+	dataEnd += received;
+	totalBytesRead += received;
+	if (!file)
+	{
+		endOfFile = true;
+	}
+	return true;
+}
+
+//Read up to 'batchSize' contestants, one line each, into the first rows of 'contestants' and 'answerMatrix'
+size_t ContestantBatchReader::readBatch(unique_ptr<Contestant[]>& contestants, AnswerMatrix& answerMatrix, size_t batchSize)
+{
+	size_t numRead{ 0 }; //contestants read into this batch so far
+	while (numRead < batchSize)
+	{
+		//skip blank space between lines; if nothing is left in the buffer, read more (or stop at end of file)
+		const char* cursor = skipWhitespace(buffer.get() + dataBegin, buffer.get() + dataEnd);
+		dataBegin = static_cast<size_t>(cursor - buffer.get());
+		if (dataBegin == dataEnd)
+		{
+			if (!fillBuffer())
+			{
+				break;
+			}
+			continue;
+		}
+
+		//find the end of this contestant's line; if it is not in the buffer yet, read more first (the last line may have no newline)
+		const char* lineEnd = static_cast<const char*>(memchr(cursor, '\n', dataEnd - dataBegin));
+		if (lineEnd == nullptr)
+		{
+			if (fillBuffer())
+			{
+				continue;
+			}
+			lineEnd = buffer.get() + dataEnd;
+		}
+
+		//parse the line straight into the next row of the batch
+		parseContestant(cursor, lineEnd, numQuestions, blankAnswer, *(contestants.get() + numRead), answerMatrix.row(numRead));
+		dataBegin = static_cast<size_t>(lineEnd - buffer.get());
+		++numRead;
+	}
+	return numRead;
+}
+
+//Function to process the Contestant file; reads contestant ids into dynamically allocated array and their answers into the answer matrix
+unique_ptr<Contestant[]> processContestantFile(const string& contestantsFilename, const size_t numQuestions, char blankAnswer, size_t& numContestants, AnswerMatrix& answerMatrix, size_t& bytesRead)
+{
+	//map contestant file into memory (read-only)
+	MappedFile cfile(contestantsFilename);
+
+	//if contestant file cannot be successfully opened
+	if (!cfile.isOpen())
+	{
+		cerr << "contestant file could not be opened for reading.\n"; //print an error to the console
+		exit(1); //and exit the program
+	}
+	bytesRead = cfile.sizeInBytes();
+
+	//create dynamically allocated array of type 'Contestant'(holds the id) and the matching answer matrix - both are sized and grown while parsing
+	unique_ptr<Contestant[]> contestants{};
+	size_t capacity{ 0 };
+	numContestants = parseContestantText(cfile.begin(), cfile.end(), numQuestions, blankAnswer, contestants, capacity, answerMatrix);
+	return contestants; //return unique_ptr managing dynamically allocated array of Contestants, which holds their IDs
+}
+
+/* Function to read every contestant in the text [begin, end) into the contestant table and answer matrix, returning how many were read :
+   the table and matrix are reused as they are if they are big enough (with 'capacity' rows each), so a caller scoring many files
+   (such as '--batch') allocates them only when a file needs more rows than any before it */
+size_t parseContestantText(const char* begin, const char* end, size_t numQuestions, char blankAnswer, unique_ptr<Contestant[]>& contestants, size_t& capacity, AnswerMatrix& answerMatrix)
+{
+	const char* cursor = skipWhitespace(begin, end); //current read position in the text
+
+	/* estimate the number of contestants from the length of the first line, so the table rarely needs to grow :
+	   every line has the same layout, so the file size divided by one line's length is close to the real count */
+	const char* firstLineEnd = find(cursor, end, '\n');
+	size_t estimate{ static_cast<size_t>(end - cursor) / static_cast<size_t>(firstLineEnd - cursor + 1) + 1 };
+
+	//allocate the table and matrix if they are too small, or if the rows of this quiz are a different width
+	size_t rowStride{ paddedRowStride(numQuestions) };
+	if (capacity < estimate || answerMatrix.rowStride != rowStride)
+	{
+		capacity = max(capacity, estimate);
+		contestants = unique_ptr<Contestant[]>(new Contestant[capacity]);
+		answerMatrix.rowStride = rowStride;
+		answerMatrix.data = allocateAlignedRows(capacity, rowStride);
+		answerMatrix.capacity = capacity;
+	}
+
+	//read contestants one at a time until the end of the text is reached
+	size_t numContestants{ 0 };
+	while (cursor < end)
+	{
+		//if the table is full, double its size
+		if (numContestants == capacity)
+		{
+			capacity *= 2;
+			growContestantTable(contestants, numContestants, capacity);
+			growAnswerMatrix(answerMatrix, numContestants, capacity);
+		}
+		//read contestant's line (id and answers) straight into the next entry of the table and row of the answer matrix;
+		//a contestant never reads past its own line, so a short row is padded with blanks just as the '--stream' reader does
+		char* answerRow = answerMatrix.row(numContestants);
+		const char* lineEnd = find(cursor, end, '\n');
+		parseContestant(cursor, lineEnd, numQuestions, blankAnswer, *(contestants.get() + numContestants), answerRow);
+		cursor = lineEnd;
+		//a reused row may hold answers from a longer quiz in its padding; padding must stay zero to match the padded key
+		memset(answerRow + numQuestions, 0, rowStride - numQuestions);
+		++numContestants;
+
+		cursor = skipWhitespace(cursor, end); //move to the start of the next contestant's id
+	}
+	return numContestants;
+}
+
+//Scalar scoring kernel: compares the row one byte at a time (used when no SIMD instruction set is available)
+size_t scoreRowScalar(const char* row, const char* key, size_t rowStride, uint64_t* wrongMask)
+{
+	size_t wrongCount{ 0 };
+	//build one 64-bit mask per cache line of the row
+	for (size_t block = 0; block < rowStride / cacheLineSize; ++block)
+	{
+		uint64_t wrongBits{ 0 };
+		for (size_t k = 0; k < cacheLineSize; ++k)
+		{
+			size_t j{ block * cacheLineSize + k };
+			wrongBits |= static_cast<uint64_t>(*(row + j) != *(key + j)) << k; //written without a branch so the compiler can vectorize it
+		}
+		*(wrongMask + block) = wrongBits;
+		wrongCount += countSetBits(wrongBits);
+	}
+	return wrongCount;
+}
+
+#if QUIZ_X86_KERNELS
+//SSE2 scoring kernel: compares 16 answers per instruction and gathers four 16-bit equality masks into each 64-bit word
+__attribute__((target("sse2,popcnt")))
+size_t scoreRowSse2(const char* row, const char* key, size_t rowStride, uint64_t* wrongMask)
+{
+	size_t wrongCount{ 0 };
+	for (size_t block = 0; block < rowStride / cacheLineSize; ++block)
+	{
+		uint64_t equalBits{ 0 };
+		for (size_t k = 0; k < cacheLineSize; k += 16)
+		{
+			size_t j{ block * cacheLineSize + k };
+			__m128i answers = _mm_load_si128(reinterpret_cast<const __m128i*>(row + j));
+			__m128i correct = _mm_load_si128(reinterpret_cast<const __m128i*>(key + j));
+			equalBits |= static_cast<uint64_t>(static_cast<unsigned>(_mm_movemask_epi8(_mm_cmpeq_epi8(answers, correct)))) << k;
+		}
+		*(wrongMask + block) = ~equalBits;
+		wrongCount += countSetBits(~equalBits);
+	}
+	return wrongCount;
+}
+
+//AVX2 scoring kernel: same as the SSE2 kernel but 32 answers per instruction
+__attribute__((target("avx2,popcnt")))
+size_t scoreRowAvx2(const char* row, const char* key, size_t rowStride, uint64_t* wrongMask)
+{
+	size_t wrongCount{ 0 };
+	for (size_t block = 0; block < rowStride / cacheLineSize; ++block)
+	{
+		uint64_t equalBits{ 0 };
+		for (size_t k = 0; k < cacheLineSize; k += 32)
+		{
+			size_t j{ block * cacheLineSize + k };
+			__m256i answers = _mm256_load_si256(reinterpret_cast<const __m256i*>(row + j));
+			__m256i correct = _mm256_load_si256(reinterpret_cast<const __m256i*>(key + j));
+			equalBits |= static_cast<uint64_t>(static_cast<unsigned>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(answers, correct)))) << k;
+		}
+		*(wrongMask + block) = ~equalBits;
+		wrongCount += countSetBits(~equalBits);
+	}
+	return wrongCount;
+}
+#endif
+
+//Function to pick the widest scoring kernel the CPU we are running on supports
+RowScoringKernel selectRowScoringKernel()
+{
+#if QUIZ_X86_KERNELS
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("popcnt"))
+	{
+		return scoreRowAvx2;
+	}
+	if (__builtin_cpu_supports("sse2") && __builtin_cpu_supports("popcnt"))
+	{
+		return scoreRowSse2;
+	}
+#endif
+	return scoreRowScalar;
+}
+
+//Function to create the result arrays for 'numContestants' contestants: scores, masks, and zeroed miss counters and score histogram
+ScoringResults allocateScoringResults(size_t numContestants, size_t numQuestions, size_t maskWords, const ScoreScale& scale)
+{
+	ScoringResults results{};
+	results.maskWords = maskWords;
+	results.scale = scale;
+	results.allScores = unique_ptr<double[]>(new double[numContestants]);
+	results.missedQuestionsCounter = unique_ptr<size_t[]>(new size_t[numQuestions]{});
+	results.scoreHistogram = unique_ptr<size_t[]>(new size_t[scale.levels]{});
+	results.wrongQuestionMasks = unique_ptr<uint64_t[]>(new uint64_t[numContestants * maskWords]);
+	return results;
+}
+
+//Helper to record one scored contestant: add their misses and histogram position (marks above the lowest possible) to a worker's tallies, and store their score
+inline void tallyContestant(ScoringResults& results, WorkerTallies& tallies, size_t i, const uint64_t* wrongMask, size_t scoreLevel, size_t weight)
+{
+	//add each wrong answer to the miss counter for its question (visits only the set bits)
+	//'weight' is the number of contestants the row stands for: 1, or with '--dedup' everyone who gave exactly these answers
+	for (size_t word = 0; word < results.maskWords; ++word)
+	{
+		for (uint64_t bits = *(wrongMask + word); bits != 0; bits &= bits - 1)
+		{
+			*(tallies.missedQuestionsCounter.get() + word * 64 + lowestSetBit(bits)) += weight;
+		}
+	}
+	*(tallies.scoreHistogram.get() + scoreLevel) += weight; //more contestants with these marks
+
+	//calculate contestant's score and store it:
+	//divide their marks by the marks for a perfect paper (with the plain scheme, correct answers by questions), multiply by 100 to get as percent
+	double score{ results.scale.score(scoreLevel) };
+	*(results.allScores.get() + i) = score; //assign calculated score to corresponding position in 'allScores' array
+}
+
+//Function to allocate zeroed item-analysis counts for a quiz with 'numQuestions' questions
+ItemCounts allocateItemCounts(size_t numQuestions)
+{
+	ItemCounts items{};
+	items.optionTallies = unique_ptr<size_t[]>(new size_t[numQuestions * itemRowWords]{});
+	items.correctByScore = unique_ptr<size_t[]>(new size_t[numQuestions * (numQuestions + 1)]{});
+	return items;
+}
+
+//Helper to add 'count' counters from 'source' into 'total'
+inline void addCounts(size_t* total, const size_t* source, size_t count)
+{
+	for (size_t k = 0; k < count; ++k)
+	{
+		*(total + k) += *(source + k);
+	}
+}
+
+/* Helper to add one scored contestant's answers to a worker's item-analysis counts :
+   each answer counts towards its own column (and adds the contestant's total to that column's score sum),
+   and every question they got right counts towards the row for their number of correct answers */
+inline void tallyItemResponses(WorkerTallies& tallies, const char* answerRow, const uint64_t* wrongMask, size_t correctAnswerCount, size_t numQuestions, size_t weight)
+{
+	size_t* optionTallies = tallies.optionTallies.get();
+	for (size_t j = 0; j < numQuestions; ++j)
+	{
+		//count and score sum sit side by side, so each answer touches one cache line
+		size_t* cell = optionTallies + j * itemRowWords + 2 * static_cast<unsigned char>(*(answerRow + j));
+		*cell += weight;
+		*(cell + 1) += correctAnswerCount * weight;
+	}
+
+	//correct answers are the clear bits of the wrong-question mask; padding past the last question always matches, so it is masked off
+	size_t* correctByScore = tallies.correctByScore.get() + correctAnswerCount;
+	for (size_t word = 0; word * 64 < numQuestions; ++word)
+	{
+		size_t questionsInWord{ min<size_t>(numQuestions - word * 64, 64) };
+		uint64_t inQuiz{ questionsInWord == 64 ? ~uint64_t{ 0 } : (uint64_t{ 1 } << questionsInWord) - 1 };
+		for (uint64_t bits = ~*(wrongMask + word) & inQuiz; bits != 0; bits &= bits - 1)
+		{
+			*(correctByScore + (word * 64 + lowestSetBit(bits)) * (numQuestions + 1)) += weight;
+		}
+	}
+}
+
+/* Function to run 'scoreRange(begin, end, tallies)' over all contestants on 'numThreads' threads, then merge the tallies into 'results' :
+   the contestants are cut into chunks; each thread starts on its own share of chunks and, once that runs out,
+   steals the remaining chunks of the other threads. Each thread counts into its own tallies, merged at the end */
+template <typename RangeScorer>
+void scoreInParallel(size_t numContestants, size_t numQuestions, size_t numThreads, ScoringResults& results, RangeScorer scoreRange)
+{
+	//cut the contestants into chunks small enough to balance the load, but large enough that taking one is cheap
+	numThreads = max<size_t>(numThreads, 1);
+	size_t chunkSize{ max<size_t>(numContestants / (numThreads * 16), 256) };
+	size_t numChunks{ (numContestants + chunkSize - 1) / chunkSize };
+	numThreads = max<size_t>(min(numThreads, numChunks), 1); //no point starting threads that would have nothing to do
+
+	//give each thread its own tallies and an equal share of the chunks
+	unique_ptr<WorkerTallies[]> tallies(new WorkerTallies[numThreads]);
+	unique_ptr<ChunkQueue[]> queues(new ChunkQueue[numThreads]);
+	for (size_t t = 0; t < numThreads; ++t)
+	{
+		(tallies.get() + t)->missedQuestionsCounter = allocateAligned<size_t>(numQuestions);
+		(tallies.get() + t)->scoreHistogram = allocateAligned<size_t>(results.scale.levels);
+		if (results.items.optionTallies)
+		{
+			(tallies.get() + t)->optionTallies = allocateAligned<size_t>(numQuestions * itemRowWords);
+			(tallies.get() + t)->correctByScore = allocateAligned<size_t>(numQuestions * (numQuestions + 1));
+		}
+		(queues.get() + t)->nextChunk.store(numChunks * t / numThreads);
+		(queues.get() + t)->endChunk = numChunks * (t + 1) / numThreads;
+	}
+
+	//each worker drains its own queue first, then visits the other queues in turn and steals whatever chunks are left
+	auto worker = [&](size_t self)
+	{
+		for (size_t k = 0; k < numThreads; ++k)
+		{
+			ChunkQueue& queue = *(queues.get() + (self + k) % numThreads);
+			for (size_t chunk = queue.nextChunk.fetch_add(1, memory_order_relaxed); chunk < queue.endChunk; chunk = queue.nextChunk.fetch_add(1, memory_order_relaxed))
+			{
+				size_t begin{ chunk * chunkSize };
+				scoreRange(begin, min(begin + chunkSize, numContestants), *(tallies.get() + self));
+			}
+		}
+	};
+
+	//run the workers (the calling thread is worker 0, so a single-threaded run starts no threads at all)
+	vector<thread> threads;
+	for (size_t t = 1; t < numThreads; ++t)
+	{
+		threads.emplace_back(worker, t);
+	}
+	worker(0);
+	for (thread& workerThread : threads)
+	{
+		workerThread.join();
+	}
+
+	//merge every worker's tallies into the results (integer sums, so the totals do not depend on how the work was split)
+	for (size_t t = 0; t < numThreads; ++t)
+	{
+		for (size_t j = 0; j < numQuestions; ++j)
+		{
+			*(results.missedQuestionsCounter.get() + j) += *((tallies.get() + t)->missedQuestionsCounter.get() + j);
+		}
+		for (size_t k = 0; k < results.scale.levels; ++k)
+		{
+			*(results.scoreHistogram.get() + k) += *((tallies.get() + t)->scoreHistogram.get() + k);
+		}
+		if (results.items.optionTallies)
+		{
+			const WorkerTallies& worker = *(tallies.get() + t);
+			addCounts(results.items.optionTallies.get(), worker.optionTallies.get(), numQuestions * itemRowWords);
+			addCounts(results.items.correctByScore.get(), worker.correctByScore.get(), numQuestions * (numQuestions + 1));
+		}
+	}
+}
+
+//Helper to add up the marks of the questions set in one 64-bit mask word: one table lookup for every 8 questions
+inline int64_t wordMarks(const int32_t* wordTable, uint64_t bits)
+{
+	int64_t marks{ 0 };
+	for (size_t byte = 0; byte < 8; ++byte)
+	{
+		marks += *(wordTable + byte * 256 + ((bits >> (byte * 8)) & 0xFF));
+	}
+	return marks;
+}
+
+/* Marking policies for the scoring loops, one type per scoring scheme, so each loop is compiled for exactly one scheme and the plain one pays nothing for the others :
+   'level' turns a scored row into its score histogram position (its marks above the lowest possible marks).
+   'usesAnsweredMask' says whether the loop must also find the blank answers, as a mask of the questions that were answered */
+//Plain scheme: the position is just the number of correct answers
+struct PlainMarks
+{
+	static constexpr bool usesAnsweredMask{ false };
+	size_t level(const uint64_t*, const uint64_t*, size_t correctAnswerCount) const { return correctAnswerCount; }
+};
+
+//Weighted scheme: full marks, less the marks of every question not answered correctly (wrong and blank answers alike)
+struct WeightedMarks
+{
+	static constexpr bool usesAnsweredMask{ false };
+	const ScoringScheme& scheme;
+	size_t maskWords;
+	size_t level(const uint64_t* wrongMask, const uint64_t*, size_t) const
+	{
+		int64_t marks{ scheme.scale.totalMarks };
+		for (size_t word = 0; word < maskWords; ++word)
+		{
+			marks -= wordMarks(scheme.correctMarkTable.get() + word * marksTableWordEntries, *(wrongMask + word));
+		}
+		return static_cast<size_t>(marks - scheme.scale.lowestMarks);
+	}
+};
+
+//Negative marking: as weighted, plus the (zero or negative) marks of every wrong answer that was not left blank
+struct NegativeMarks
+{
+	static constexpr bool usesAnsweredMask{ true };
+	const ScoringScheme& scheme;
+	size_t maskWords;
+	size_t level(const uint64_t* wrongMask, const uint64_t* answeredMask, size_t) const
+	{
+		int64_t marks{ scheme.scale.totalMarks };
+		for (size_t word = 0; word < maskWords; ++word)
+		{
+			marks -= wordMarks(scheme.correctMarkTable.get() + word * marksTableWordEntries, *(wrongMask + word));
+			marks += wordMarks(scheme.wrongMarkTable.get() + word * marksTableWordEntries, *(wrongMask + word) & *(answeredMask + word));
+		}
+		return static_cast<size_t>(marks - scheme.scale.lowestMarks);
+	}
+};
+
+//Helper to score contestants 'begin' to 'end' (not including 'end'), adding their misses and histogram positions to one worker's tallies
+//(each row counts 'rowWeights[i]' times if weights are given, and once otherwise)
+template <typename Marking>
+void scoreContestantRange(const AnswerMatrix& answerMatrix, size_t begin, size_t end, const char* paddedKey, size_t numQuestions, RowScoringKernel scoreRow, const Marking& marking, const char* blankRow, const size_t* rowWeights, ScoringResults& results, WorkerTallies& tallies)
+{
+	//questions each contestant answered (did not leave blank), only needed by schemes that treat blank answers differently from wrong ones
+	unique_ptr<uint64_t[]> answeredMask(Marking::usesAnsweredMask ? new uint64_t[results.maskWords] : nullptr);
+
+	//iterate through each contestant in the range to calculate score and evaluate answers
+	for (size_t i = begin; i < end; ++i)
+	{
+		uint64_t* wrongMask = results.wrongQuestionMasks.get() + i * results.maskWords; //this contestant's wrong-question bits
+
+		//compare the contestant's whole row against the answer key at once, recording a bit for every wrong answer
+		size_t wrongAnswerCount{ scoreRow(answerMatrix.row(i), paddedKey, answerMatrix.rowStride, wrongMask) };
+		if constexpr (Marking::usesAnsweredMask)
+		{
+			//the same kernel against a row of blanks marks every answer that is not blank
+			scoreRow(answerMatrix.row(i), blankRow, answerMatrix.rowStride, answeredMask.get());
+		}
+		size_t weight{ (rowWeights != nullptr) ? *(rowWeights + i) : 1 };
+		tallyContestant(results, tallies, i, wrongMask, marking.level(wrongMask, answeredMask.get(), numQuestions - wrongAnswerCount), weight);
+
+		//with '--items', count the same row's answers into the item-analysis tables while it is still in cache
+		if (tallies.optionTallies)
+		{
+			tallyItemResponses(tallies, answerMatrix.row(i), wrongMask, numQuestions - wrongAnswerCount, numQuestions, weight);
+		}
+	}
+}
+
+/* Function to calculate contestant scores, count misses per question and record which questions each contestant got wrong,
+   all in one pass over the answer matrix (reports and the summary then work from these results without comparing answers again).
+   with more than one thread the work is shared out by 'scoreInParallel'; the results are the same for any thread count.
+   the scoring loop is compiled once per scoring scheme, and the scheme picks which one runs */
+ScoringResults calculateContestantScores(const AnswerMatrix& answerMatrix, size_t numContestants, const unique_ptr<char[]>& correctAnswers, size_t numQuestions, size_t numThreads, bool analyseItems, const ScoringScheme& scheme)
+{
+	return scoreAnswerRows(answerMatrix, numContestants, correctAnswers, numQuestions, numThreads, analyseItems, scheme, nullptr);
+}
+
+/* Function to score 'numRows' answer rows, as 'calculateContestantScores' does, but with each row standing for 'rowWeights[i]' contestants :
+   scores and wrong-question masks are per row, while the miss counters, histogram and item counts count every contestant a row stands for.
+   without weights (nullptr) every row is one contestant */
+ScoringResults scoreAnswerRows(const AnswerMatrix& answerMatrix, size_t numRows, const unique_ptr<char[]>& correctAnswers, size_t numQuestions, size_t numThreads, bool analyseItems, const ScoringScheme& scheme, const size_t* rowWeights)
+{
+	//create dynamically allocated arrays to store scores for all rows, miss counts for all questions (zeroed), the score histogram (zeroed) and the wrong-question masks
+	ScoringResults results = allocateScoringResults(numRows, numQuestions, answerMatrix.rowStride / cacheLineSize, scheme.scale);
+	if (analyseItems)
+	{
+		results.items = allocateItemCounts(numQuestions); //also tells 'scoreInParallel' to give each thread item counts
+	}
+	scoreAnswerRowsInto(results, answerMatrix, numRows, correctAnswers, numQuestions, numThreads, scheme, rowWeights);
+	return results; //return the scores, miss counters, score histogram, wrong-question masks (and item counts if asked for)
+}
+
+/* Function to score 'numRows' answer rows into results that already exist, as 'scoreAnswerRows' does, so a caller scoring batch after batch
+   (such as '--pipeline') can reuse one set of result arrays : 'results' must have room for at least 'numRows' rows (and item counts, if wanted),
+   and its miss counters, histogram and item counts are cleared first */
+void scoreAnswerRowsInto(ScoringResults& results, const AnswerMatrix& answerMatrix, size_t numRows, const unique_ptr<char[]>& correctAnswers, size_t numQuestions, size_t numThreads, const ScoringScheme& scheme, const size_t* rowWeights)
+{
+	fill(results.missedQuestionsCounter.get(), results.missedQuestionsCounter.get() + numQuestions, size_t{ 0 });
+	fill(results.scoreHistogram.get(), results.scoreHistogram.get() + results.scale.levels, size_t{ 0 });
+	if (results.items.optionTallies)
+	{
+		fill(results.items.optionTallies.get(), results.items.optionTallies.get() + numQuestions * itemRowWords, size_t{ 0 });
+		fill(results.items.correctByScore.get(), results.items.correctByScore.get() + numQuestions * (numQuestions + 1), size_t{ 0 });
+	}
+
+	//copy the answer key into an aligned row padded the same way as the contestants' rows, so both can be compared chunk by chunk
+	unique_ptr<char[], AlignedDeleter<char>> paddedKey = allocateAlignedRows(1, answerMatrix.rowStride);
+	memcpy(paddedKey.get(), correctAnswers.get(), numQuestions);
+
+	RowScoringKernel scoreRow = selectRowScoringKernel(); //widest kernel this CPU supports
+
+	auto scoreWith = [&](const auto& marking)
+	{
+		scoreInParallel(numRows, numQuestions, numThreads, results, [&](size_t begin, size_t end, WorkerTallies& tallies)
+		{
+			scoreContestantRange(answerMatrix, begin, end, paddedKey.get(), numQuestions, scoreRow, marking, scheme.blankRow.get(), rowWeights, results, tallies);
+		});
+	};
+	switch (scheme.policy)
+	{
+	case ScoringPolicy::Plain:
+		scoreWith(PlainMarks{});
+		break;
+	case ScoringPolicy::Weighted:
+		scoreWith(WeightedMarks{ scheme, results.maskWords });
+		break;
+	case ScoringPolicy::NegativeMarking:
+		scoreWith(NegativeMarks{ scheme, results.maskWords });
+		break;
+	}
+}
+
+//Function to make the histogram scale of the plain scheme: one position per number of correct answers, 0 to 'numQuestions'
+ScoreScale correctCountScale(size_t numQuestions)
+{
+	return ScoreScale{ numQuestions + 1, 0, static_cast<int64_t>(numQuestions) };
+}
+
+//Function to make the plain scheme (one mark per correct answer), used when a quiz has no scheme file
+ScoringScheme plainScoringScheme(size_t numQuestions)
+{
+	ScoringScheme scheme{};
+	scheme.scale = correctCountScale(numQuestions);
+	return scheme;
+}
+
+//Helper to build a marks table: entry 'group * 256 + subset' is the total marks of the questions in 'subset' of the 8 questions of that group
+unique_ptr<int32_t[]> buildMarksTable(const vector<int64_t>& marks, size_t maskWords)
+{
+	unique_ptr<int32_t[]> table(new int32_t[maskWords * marksTableWordEntries]{});
+	for (size_t group = 0; group < maskWords * 8; ++group)
+	{
+		int32_t* groupTable = table.get() + group * 256;
+		for (size_t subset = 1; subset < 256; ++subset)
+		{
+			//a subset's marks are those of the subset without its lowest question, plus that question's own (padding questions have none)
+			size_t j{ group * 8 + lowestSetBit(subset) };
+			*(groupTable + subset) = *(groupTable + (subset & (subset - 1))) + (j < marks.size() ? static_cast<int32_t>(marks.at(j)) : 0);
+		}
+	}
+	return table;
+}
+
+/* Function to build a scoring scheme from each question's marks for a correct answer and for a wrong answer :
+   the cheapest policy that gives the same scores is chosen, so one mark per question with nothing off for wrong answers is the plain scheme.
+   marks the histogram cannot hold set 'error' and give the plain scheme; the caller decides whether that stops the run or just one quiz */
+ScoringScheme buildScoringScheme(const vector<int64_t>& correctMarks, const vector<int64_t>& wrongMarks, char blankAnswer, size_t numQuestions, string& error)
+{
+	ScoringScheme scheme{};
+	scheme.blankAnswer = blankAnswer;
+	bool everyMarkOne{ all_of(correctMarks.begin(), correctMarks.end(), [](int64_t marks) { return marks == 1; }) };
+	bool anyPenalty{ any_of(wrongMarks.begin(), wrongMarks.end(), [](int64_t marks) { return marks != 0; }) };
+	scheme.policy = anyPenalty ? ScoringPolicy::NegativeMarking : everyMarkOne ? ScoringPolicy::Plain : ScoringPolicy::Weighted;
+	if (scheme.policy == ScoringPolicy::Plain)
+	{
+		scheme.scale = correctCountScale(numQuestions);
+		return scheme;
+	}
+
+	//marks run from every answer wrong (with negative marking) to every answer right, and the histogram has a position for each
+	for (size_t j = 0; j < numQuestions; ++j)
+	{
+		scheme.scale.totalMarks += correctMarks.at(j);
+		scheme.scale.lowestMarks += wrongMarks.at(j);
+	}
+	if (scheme.scale.totalMarks <= 0 || scheme.scale.totalMarks - scheme.scale.lowestMarks >= (int64_t{ 1 } << 24))
+	{
+		error = "scoring scheme must give between 1 and 16777215 marks from lowest to highest score";
+		return plainScoringScheme(numQuestions);
+	}
+	scheme.scale.levels = static_cast<size_t>(scheme.scale.totalMarks - scheme.scale.lowestMarks + 1);
+
+	size_t rowStride{ paddedRowStride(numQuestions) };
+	scheme.correctMarkTable = buildMarksTable(correctMarks, rowStride / cacheLineSize);
+	if (scheme.policy == ScoringPolicy::NegativeMarking)
+	{
+		scheme.wrongMarkTable = buildMarksTable(wrongMarks, rowStride / cacheLineSize);
+		scheme.blankRow = allocateAlignedRows(1, rowStride); //padding stays zero, like every answer row
+		memset(scheme.blankRow.get(), blankAnswer, numQuestions);
+	}
+	return scheme;
+}
+
+/* Function to read the scoring scheme of a quiz from '<answer key>.scheme', next to its answer key; without that file the quiz uses the plain scheme.
+   each line of the scheme file is one setting ('#' starts a comment):
+     correct M...   marks for a correct answer: one number for every question, or one number per question (default 1)
+     wrong M...     marks for a wrong answer, zero or negative: one number for every question, or one number per question (default 0)
+     blank C        the answer that means a question was left blank (default '-'); blank answers get no marks and lose none
+   an invalid scheme file sets 'error' (and gives the plain scheme) rather than exiting, since batch workers load schemes too */
+ScoringScheme loadScoringScheme(const string& answerKeyFilename, size_t numQuestions, string& error)
+{
+	ifstream schemeFile(answerKeyFilename + ".scheme");
+	if (!schemeFile)
+	{
+		return plainScoringScheme(numQuestions);
+	}
+
+	vector<int64_t> correctMarks(numQuestions, 1);
+	vector<int64_t> wrongMarks(numQuestions, 0);
+	char blankAnswer{ defaultBlankAnswer };
+	string line;
+	for (size_t lineNumber = 1; getline(schemeFile, line); ++lineNumber)
+	{
+		istringstream fields(line.substr(0, line.find('#')));
+		string setting;
+		if (!(fields >> setting))
+		{
+			continue; //blank or comment line
+		}
+		bool valid{ false };
+		if (setting == "blank")
+		{
+			string answer;
+			valid = (fields >> answer) && answer.size() == 1 && !(fields >> setting);
+			blankAnswer = valid ? answer.at(0) : blankAnswer;
+		}
+		else if (setting == "correct" || setting == "wrong")
+		{
+			vector<int64_t> values;
+			long long value{ 0 };
+			while (fields >> value)
+			{
+				values.push_back(value);
+			}
+			//correct answers can only gain marks and wrong ones only lose them, and no question is worth more than a million
+			valid = fields.eof() && (values.size() == 1 || values.size() == numQuestions);
+			for (int64_t marks : values)
+			{
+				valid = valid && (setting == "correct" ? marks >= 0 : marks <= 0) && marks >= -1000000 && marks <= 1000000;
+			}
+			vector<int64_t>& target = (setting == "correct") ? correctMarks : wrongMarks;
+			for (size_t j = 0; valid && j < numQuestions; ++j)
+			{
+				target.at(j) = values.at(values.size() == 1 ? 0 : j);
+			}
+		}
+		if (!valid)
+		{
+			error = "scoring scheme file has an invalid setting on line " + to_string(lineNumber) + ": " + line;
+			return plainScoringScheme(numQuestions);
+		}
+	}
+	return buildScoringScheme(correctMarks, wrongMarks, blankAnswer, numQuestions, error);
+}
+
+//Function to get the name of a scoring policy, as used in messages and benchmark stage names
+const char* scoringPolicyName(ScoringPolicy policy)
+{
+	switch (policy)
+	{
+	case ScoringPolicy::Weighted:
+		return "weighted";
+	case ScoringPolicy::NegativeMarking:
+		return "negative-marking";
+	default:
+		return "plain";
+	}
+}
+
+//Function to turn a number of correct answers into a score (percent): the same formula the scoring pass uses, so the values are identical
+double scoreForCorrectCount(size_t correctAnswerCount, size_t numQuestions)
+{
+	return static_cast<double>(correctAnswerCount) / static_cast<double>(numQuestions) * 100.00;
+}
+
+//Function to calculate mean of all the contestant scores from the score histogram
+double calculateMean(const unique_ptr<size_t[]>& scoreHistogram, const ScoreScale& scale, size_t numContestants)
+{
+	//add up every contestant's marks (correct answers, with the plain scheme): each histogram bucket contributes (marks) x (number of contestants with that many)
+	//this is an exact integer, so the result does not depend on the order contestants were scored in
+	int64_t totalMarks{ 0 };
+	for (size_t k = 0; k < scale.levels; ++k)
+	{
+		totalMarks += (scale.lowestMarks + static_cast<int64_t>(k)) * static_cast<int64_t>(*(scoreHistogram.get() + k));
+	}
+	//calculate mean by dividing total by total number of contestants, then converting to a percent like a single score
+	double mean{ static_cast<double>(totalMarks) / static_cast<double>(numContestants) / static_cast<double>(scale.totalMarks) * 100.00 };
+
+	return mean; //return calculated mean
+}
+
+/* Function to find the histogram position (number of correct answers, with the plain scheme) of the contestant at position 'rank' (counting from 0) if all scores were sorted :
+   walks the histogram adding up bucket sizes until the running total passes 'rank' - O(histogram positions), with no sorting */
+size_t scoreLevelAtRank(const unique_ptr<size_t[]>& scoreHistogram, const ScoreScale& scale, size_t rank)
+{
+	size_t contestantsSoFar{ 0 }; //number of contestants in the buckets visited so far
+	for (size_t k = 0; k < scale.levels; ++k)
+	{
+		contestantsSoFar += *(scoreHistogram.get() + k);
+		if (contestantsSoFar > rank)
+		{
+			return k;
+		}
+	}
+	return scale.levels - 1; //rank past the last contestant: clamp to the top bucket
+}
+
+//Function to calculate the median of the contestants' scores from the score histogram
+double calculateMedian(const unique_ptr<size_t[]>& scoreHistogram, const ScoreScale& scale, size_t numContestants)
+{
+	//calculate median score from the middle position(s) of the (virtually) sorted scores:
+	double median{ 0.0 }; //create median variable with value 0.0 (to be replaced with actual median)
+
+	if (numContestants % 2 == 1) //if we have an odd number of scores
+	{
+		//our median is the value at the middle position (numContestants/2)
+		median = scale.score(scoreLevelAtRank(scoreHistogram, scale, numContestants / 2));
+	}
+	else if (numContestants > 0) //otherwise, if we have an even number of scores
+	{
+		//the median is the average of the two middle scores located at positions [numContestants/2 - 1] and [numContestants / 2]
+		double lowerMiddle{ scale.score(scoreLevelAtRank(scoreHistogram, scale, (numContestants / 2) - 1)) };
+		double upperMiddle{ scale.score(scoreLevelAtRank(scoreHistogram, scale, numContestants / 2)) };
+		median = (lowerMiddle + upperMiddle) / 2.0;
+	}
+	return median; //return calculated median
+}
+
+//Function to find the mode(s) of the scores: every score whose histogram bucket is the largest, in ascending order
+vector<double> calculateModes(const unique_ptr<size_t[]>& scoreHistogram, const ScoreScale& scale)
+{
+	//create a vector to store the mode(s)
+	vector<double> modes;
+
+	//find the highest frequency of any score
+	size_t highestFrequency{ 0 };
+	for (size_t k = 0; k < scale.levels; ++k)
+	{
+		highestFrequency = max(highestFrequency, *(scoreHistogram.get() + k));
+	}
+
+	//every score that appears that often is a mode (a frequency of 0 means there are no scores at all)
+	for (size_t k = 0; k < scale.levels && highestFrequency > 0; ++k)
+	{
+		if (*(scoreHistogram.get() + k) == highestFrequency)
+		{
+			modes.push_back(scale.score(k));
+		}
+	}
+	return modes; //return our vector containing the mode(s)
+}
+
+/* Function to calculate any percentile (0 to 100) of the scores from the score histogram :
+   uses linear interpolation between the two closest ranks, so the 50th percentile matches the median */
+double calculatePercentile(const unique_ptr<size_t[]>& scoreHistogram, const ScoreScale& scale, size_t numContestants, double percentile)
+{
+	if (numContestants == 0)
+	{
+		return 0.0;
+	}
+	double position{ min(max(percentile, 0.0), 100.0) / 100.0 * static_cast<double>(numContestants - 1) }; //fractional rank
+	size_t lowerRank{ static_cast<size_t>(position) };
+	size_t upperRank{ min(lowerRank + 1, numContestants - 1) };
+	double fraction{ position - static_cast<double>(lowerRank) };
+
+	double lowerScore{ scale.score(scoreLevelAtRank(scoreHistogram, scale, lowerRank)) };
+	double upperScore{ scale.score(scoreLevelAtRank(scoreHistogram, scale, upperRank)) };
+	return lowerScore + (upperScore - lowerScore) * fraction;
+}
+
+//Helper to call 'visit(questionIndex)' for every set bit of a wrong-question mask, in question order
+template <typename Visitor>
+inline void forEachWrongQuestion(const uint64_t* wrongMask, size_t maskWords, Visitor visit)
+{
+	for (size_t word = 0; word < maskWords; ++word)
+	{
+		for (uint64_t bits = *(wrongMask + word); bits != 0; bits &= bits - 1)
+		{
+			visit(word * 64 + lowestSetBit(bits));
+		}
+	}
+}
+
+//Create a report writer; CSV output starts with a header row and binary output with a small file header
+ReportWriter::ReportWriter(ostream& out, ReportFormat format, size_t numQuestions)
+	: out(&out), format(format), numQuestions(numQuestions), buffer(new char[bufferSize])
+{
+	writeHeader();
+}
+
+//Finish the current report and start another one on 'newOut'; the buffer is reused, so batch runs allocate it only once per worker
+void ReportWriter::restart(ostream& newOut, ReportFormat newFormat, size_t newNumQuestions)
+{
+	flush();
+	out = &newOut;
+	format = newFormat;
+	numQuestions = newNumQuestions;
+	totalBytes = 0;
+	writeHeader();
+}
+
+//Start the report with the format's header, if it has one
+void ReportWriter::writeHeader()
+{
+	if (format == ReportFormat::Csv)
+	{
+		const char header[] = "id,score,wrong_questions,given_answers,correct_answers\n";
+		put(header, sizeof(header) - 1);
+	}
+	else if (format == ReportFormat::Binary)
+	{
+		//file header: 4-byte magic "QRB1", then the number of questions as a 32-bit integer
+		uint32_t questions{ static_cast<uint32_t>(numQuestions) };
+		putRaw("QRB1", 4);
+		putRaw(&questions, sizeof(questions));
+	}
+}
+
+//Flush whatever is left when the writer goes out of scope
+ReportWriter::~ReportWriter()
+{
+	flush();
+}
+
+//Hand everything formatted so far to the output stream in one block
+void ReportWriter::flush()
+{
+	if (used > 0)
+	{
+		out->write(buffer.get(), static_cast<streamsize>(used));
+		totalBytes += used;
+		used = 0;
+	}
+	out->flush();
+}
+
+//Make room for 'bytes' more bytes: flush if the buffer is too full, and grow it if one record alone is bigger than the buffer
+void ReportWriter::reserve(size_t bytes)
+{
+	if (used + bytes <= bufferSize)
+	{
+		return;
+	}
+	flush();
+	if (bytes > bufferSize)
+	{
+		bufferSize = bytes;
+		buffer = unique_ptr<char[]>(new char[bufferSize]);
+	}
+}
+
+//Append 'length' bytes of 'text'
+void ReportWriter::put(const char* text, size_t length)
+{
+	memcpy(buffer.get() + used, text, length);
+	used += length;
+}
+
+//Append a whole number in decimal
+void ReportWriter::putNumber(size_t number)
+{
+	to_chars_result result = to_chars(buffer.get() + used, buffer.get() + bufferSize, number);
+	used = static_cast<size_t>(result.ptr - buffer.get());
+}
+
+//Append a score with two decimal places
+void ReportWriter::putScore(double score)
+{
+	to_chars_result result = to_chars(buffer.get() + used, buffer.get() + bufferSize, score, chars_format::fixed, 2);
+	used = static_cast<size_t>(result.ptr - buffer.get());
+}
+
+//Append text as the contents of a JSON string, escaping quotes and backslashes (ids and answers never contain whitespace or control characters)
+void ReportWriter::putEscaped(string_view text)
+{
+	for (char c : text)
+	{
+		if (c == '"' || c == '\\')
+		{
+			put('\\');
+		}
+		put(c);
+	}
+}
+
+//Format one contestant's report in the writer's format
+void ReportWriter::writeContestant(string_view id, double score, const uint64_t* wrongMask, size_t maskWords, const char* answerRow, const char* correctAnswers)
+{
+	//upper bound on one record: the id (escaped), fixed text and score, and per question a number, two answers and separators
+	reserve(2 * id.size() + 64 + numQuestions * 32);
+	putId(id);
+	putPatternPart(score, wrongMask, maskWords, answerRow, correctAnswers);
+}
+
+//Format one contestant's report from its id and the rest of the record, formatted earlier by 'formatPatternPart'
+void ReportWriter::writeContestant(string_view id, string_view patternPart)
+{
+	reserve(2 * id.size() + 16 + patternPart.size());
+	putId(id);
+	put(patternPart.data(), patternPart.size());
+}
+
+//Format the part of a report after the id into the buffer, then move it out to 'parts', so it can be written for any number of contestants
+void ReportWriter::formatPatternPart(string& parts, double score, const uint64_t* wrongMask, size_t maskWords, const char* answerRow, const char* correctAnswers)
+{
+	reserve(64 + numQuestions * 32);
+	size_t start{ used };
+	putPatternPart(score, wrongMask, maskWords, answerRow, correctAnswers);
+	parts.append(buffer.get() + start, used - start);
+	used = start; //nothing is written yet
+}
+
+//Format the start of a record, up to the id (space for it has been reserved)
+void ReportWriter::putId(string_view id)
+{
+	switch (format)
+	{
+	case ReportFormat::Text:
+		put(id.data(), id.size());
+		break;
+
+	case ReportFormat::Csv:
+	{
+		//an id holding a comma or quote is quoted, with its quotes doubled
+		bool quoteId{ id.find_first_of(",\"") != string_view::npos };
+		if (quoteId)
+		{
+			put('"');
+			for (char c : id)
+			{
+				if (c == '"')
+				{
+					put('"'); //CSV escapes a quote by doubling it
+				}
+				put(c);
+			}
+			put('"');
+		}
+		else
+		{
+			put(id.data(), id.size());
+		}
+		break;
+	}
+
+	case ReportFormat::JsonLines:
+		put("{\"id\":\"", 7);
+		putEscaped(id);
+		break;
+
+	case ReportFormat::Binary:
+	{
+		uint32_t idLength{ static_cast<uint32_t>(id.size()) };
+		putRaw(&idLength, sizeof(idLength));
+		put(id.data(), id.size());
+		break;
+	}
+	}
+}
+
+//Format the rest of a record after the id: everything that depends only on the answers (space for it has been reserved)
+void ReportWriter::putPatternPart(double score, const uint64_t* wrongMask, size_t maskWords, const char* answerRow, const char* correctAnswers)
+{
+	//check whether the contestant has any incorrect answers
+	bool anyIncorrect{ false };
+	for (size_t word = 0; word < maskWords; ++word)
+	{
+		anyIncorrect = anyIncorrect || *(wrongMask + word) != 0;
+	}
+
+	switch (format)
+	{
+	case ReportFormat::Text:
+		//"id - score", then (if anything was missed) the missed question numbers, the contestant's answers and the correct answers, then a blank line
+		put(" - ", 3);
+		putScore(score);
+		put('\n');
+		if (anyIncorrect)
+		{
+			forEachWrongQuestion(wrongMask, maskWords, [&](size_t j) { putNumber(j + 1); put(' '); });
+			put('\n');
+			forEachWrongQuestion(wrongMask, maskWords, [&](size_t j) { put(*(answerRow + j)); put(' '); });
+			put('\n');
+			forEachWrongQuestion(wrongMask, maskWords, [&](size_t j) { put(*(correctAnswers + j)); put(' '); });
+			put('\n');
+		}
+		put('\n');
+		break;
+
+	case ReportFormat::Csv:
+	{
+		//id,score,"missed question numbers","given answers","correct answers" (lists are space separated, so they are quoted)
+		put(',');
+		putScore(score);
+		put(",\"", 2);
+		bool first{ true };
+		forEachWrongQuestion(wrongMask, maskWords, [&](size_t j) { if (!first) put(' '); putNumber(j + 1); first = false; });
+		put("\",\"", 3);
+		first = true;
+		forEachWrongQuestion(wrongMask, maskWords, [&](size_t j) { if (!first) put(' '); if (*(answerRow + j) == '"') put('"'); put(*(answerRow + j)); first = false; });
+		put("\",\"", 3);
+		first = true;
+		forEachWrongQuestion(wrongMask, maskWords, [&](size_t j) { if (!first) put(' '); if (*(correctAnswers + j) == '"') put('"'); put(*(correctAnswers + j)); first = false; });
+		put("\"\n", 2);
+		break;
+	}
+
+	case ReportFormat::JsonLines:
+	{
+		//{"id":"...","score":12.34,"wrong":[question numbers],"given":"answers","correct":"answers"}
+		put("\",\"score\":", 10);
+		putScore(score);
+		put(",\"wrong\":[", 10);
+		bool first{ true };
+		forEachWrongQuestion(wrongMask, maskWords, [&](size_t j) { if (!first) put(','); putNumber(j + 1); first = false; });
+		put("],\"given\":\"", 11);
+		forEachWrongQuestion(wrongMask, maskWords, [&](size_t j) { char c = *(answerRow + j); if (c == '"' || c == '\\') put('\\'); put(c); });
+		put("\",\"correct\":\"", 13);
+		forEachWrongQuestion(wrongMask, maskWords, [&](size_t j) { char c = *(correctAnswers + j); if (c == '"' || c == '\\') put('\\'); put(c); });
+		put("\"}\n", 3);
+		break;
+	}
+
+	case ReportFormat::Binary:
+	{
+		//record: id length (u32), id bytes, score (f64), wrong count (u32), missed question numbers (u32 each), given answers, correct answers
+		uint32_t wrongCount{ 0 };
+		forEachWrongQuestion(wrongMask, maskWords, [&](size_t) { ++wrongCount; });
+		putRaw(&score, sizeof(score));
+		putRaw(&wrongCount, sizeof(wrongCount));
+		forEachWrongQuestion(wrongMask, maskWords, [&](size_t j) { uint32_t question{ static_cast<uint32_t>(j + 1) }; putRaw(&question, sizeof(question)); });
+		forEachWrongQuestion(wrongMask, maskWords, [&](size_t j) { put(*(answerRow + j)); });
+		forEachWrongQuestion(wrongMask, maskWords, [&](size_t j) { put(*(correctAnswers + j)); });
+		break;
+	}
+	}
+}
+
+//Function to print out contestant reports through the report writer (the wrong questions come from each contestant's wrong-question mask, so no answers are compared here)
+void printContestantReports(ReportWriter& writer, const unique_ptr<Contestant[]>& contestants, const AnswerMatrix& answerMatrix, const ScoringResults& results, size_t numContestants, const unique_ptr<char[]>& correctAnswers)
+{
+	//iterate through each contestant 
+	for (size_t i = 0; i < numContestants; ++i)
+	{
+		writer.writeContestant((contestants.get() + i)->id, *(results.allScores.get() + i), results.wrongQuestionMasks.get() + i * results.maskWords, results.maskWords, answerMatrix.row(i), correctAnswers.get());
+	}
+}
+
+//Function to check whether a contestant file is a packed file written by '--compile' (it starts with "QPK1")
+bool isPackedContestantFile(const string& filename)
+{
+	ifstream file(filename, ios::in | ios::binary);
+	char magic[4]{};
+	file.read(magic, sizeof(magic));
+	return file.gcount() == sizeof(magic) && memcmp(magic, "QPK1", sizeof(magic)) == 0;
+}
+
+/* Function to write the loaded contestants as a packed contestant file ('--compile') :
+   the alphabet is every distinct answer in the file; up to 4 options are packed at 2 bits per answer, up to 16 at 4 bits */
+void compileContestantFile(const string& outputFilename, const unique_ptr<Contestant[]>& contestants, const AnswerMatrix& answerMatrix, size_t numContestants, size_t numQuestions)
+{
+	//find every distinct answer, and give each one a code in ascending character order
+	bool seen[256]{};
+	for (size_t i = 0; i < numContestants; ++i)
+	{
+		for (size_t j = 0; j < numQuestions; ++j)
+		{
+			seen[static_cast<unsigned char>(*(answerMatrix.row(i) + j))] = true;
+		}
+	}
+	PackedFileHeader header{};
+	uint8_t codeOf[256]{};
+	for (size_t c = 0; c < 256; ++c)
+	{
+		if (seen[c])
+		{
+			if (header.alphabetSize == sizeof(header.alphabet))
+			{
+				cerr << "contestant file uses more than " << sizeof(header.alphabet) << " different answers and cannot be packed.\n";
+				exit(1);
+			}
+			codeOf[c] = static_cast<uint8_t>(header.alphabetSize);
+			header.alphabet[header.alphabetSize++] = static_cast<char>(c);
+		}
+	}
+
+	//fill in the header: section offsets follow each other, with the answer rows starting on an 8-byte boundary
+	memcpy(header.magic, "QPK1", sizeof(header.magic));
+	header.bitsPerAnswer = (header.alphabetSize <= 4) ? 2 : 4;
+	header.numQuestions = numQuestions;
+	header.numContestants = numContestants;
+	size_t fieldsPerWord{ 64 / header.bitsPerAnswer };
+	header.rowWords = (numQuestions + fieldsPerWord - 1) / fieldsPerWord;
+	header.idOffsetsOffset = sizeof(PackedFileHeader);
+	header.idBytesOffset = header.idOffsetsOffset + (numContestants + 1) * sizeof(uint64_t);
+	uint64_t idBytesSize{ 0 };
+	for (size_t i = 0; i < numContestants; ++i)
+	{
+		idBytesSize += (contestants.get() + i)->id.size();
+	}
+	header.answersOffset = (header.idBytesOffset + idBytesSize + 7) / 8 * 8;
+
+	ofstream out(outputFilename, ios::out | ios::binary);
+	if (!out) //if packed file cannot be successfully opened
+	{
+		cerr << "packed file could not be opened for writing.\n"; //print an error to the console
+		exit(1); //and exit the program
+	}
+	out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+	//id column: offsets, then the ids themselves
+	uint64_t offset{ 0 };
+	out.write(reinterpret_cast<const char*>(&offset), sizeof(offset));
+	for (size_t i = 0; i < numContestants; ++i)
+	{
+		offset += (contestants.get() + i)->id.size();
+		out.write(reinterpret_cast<const char*>(&offset), sizeof(offset));
+	}
+	for (size_t i = 0; i < numContestants; ++i)
+	{
+		out.write((contestants.get() + i)->id.data(), static_cast<streamsize>((contestants.get() + i)->id.size()));
+	}
+	const char zeroPadding[8]{};
+	out.write(zeroPadding, static_cast<streamsize>(header.answersOffset - header.idBytesOffset - idBytesSize));
+
+	//answer column: pack each row into one reused buffer of words
+	unique_ptr<uint64_t[]> packedRow(new uint64_t[header.rowWords]);
+	for (size_t i = 0; i < numContestants; ++i)
+	{
+		memset(packedRow.get(), 0, header.rowWords * sizeof(uint64_t));
+		for (size_t j = 0; j < numQuestions; ++j)
+		{
+			uint64_t code{ codeOf[static_cast<unsigned char>(*(answerMatrix.row(i) + j))] };
+			*(packedRow.get() + j / fieldsPerWord) |= code << ((j % fieldsPerWord) * header.bitsPerAnswer);
+		}
+		out.write(reinterpret_cast<const char*>(packedRow.get()), static_cast<streamsize>(header.rowWords * sizeof(uint64_t)));
+	}
+	if (!out)
+	{
+		cerr << "packed file could not be written.\n";
+		exit(1);
+	}
+	cerr << "packed " << numContestants << " contestants (" << header.alphabetSize << " options, " << header.bitsPerAnswer << " bits per answer) into " << outputFilename << '\n';
+}
+
+//Function to check a mapped packed file and set up a view of its sections; exits with an error if the file is damaged or does not match the answer key
+PackedContestants openPackedContestants(const MappedFile& file, size_t numQuestions)
+{
+	PackedContestants packed{};
+	const PackedFileHeader* header = reinterpret_cast<const PackedFileHeader*>(file.begin());
+	size_t size{ file.sizeInBytes() };
+	bool valid{ size >= sizeof(PackedFileHeader) && memcmp(header->magic, "QPK1", 4) == 0 };
+	valid = valid && (header->bitsPerAnswer == 2 || header->bitsPerAnswer == 4) && header->alphabetSize <= sizeof(header->alphabet);
+	valid = valid && header->rowWords == (header->numQuestions + (64 / header->bitsPerAnswer) - 1) / (64 / header->bitsPerAnswer);
+	//every section must lie inside the file: the id offsets, then the id bytes up to the answer rows, then the answer rows
+	valid = valid && header->idOffsetsOffset % 8 == 0 && header->numContestants < UINT64_MAX && sectionFits(header->idOffsetsOffset, header->numContestants + 1, sizeof(uint64_t), size);
+	valid = valid && header->idBytesOffset <= header->answersOffset && header->answersOffset <= size;
+	valid = valid && header->answersOffset % 8 == 0 && header->rowWords > 0 && header->numContestants <= UINT64_MAX / header->rowWords
+		&& sectionFits(header->answersOffset, header->numContestants * header->rowWords, sizeof(uint64_t), size);
+	//and every id must lie inside the id bytes, so the id offsets may never go down
+	const uint64_t* idOffsets = valid ? reinterpret_cast<const uint64_t*>(file.begin() + header->idOffsetsOffset) : nullptr;
+	for (size_t i = 0; valid && i < header->numContestants; ++i)
+	{
+		valid = *(idOffsets + i) <= *(idOffsets + i + 1);
+	}
+	valid = valid && *(idOffsets + header->numContestants) <= header->answersOffset - header->idBytesOffset;
+	if (!valid)
+	{
+		cerr << "packed contestant file is damaged.\n";
+		exit(1);
+	}
+	if (header->numQuestions != numQuestions)
+	{
+		cerr << "packed contestant file has " << header->numQuestions << " questions but the answer key has " << numQuestions << ".\n";
+		exit(1);
+	}
+	packed.header = header;
+	packed.idOffsets = idOffsets;
+	packed.idBytes = file.begin() + header->idBytesOffset;
+	packed.answerRows = reinterpret_cast<const uint64_t*>(file.begin() + header->answersOffset);
+	return packed;
+}
+
+/* Helper to turn the XOR of a packed row word and the packed key word into one bit per answer field (set where the field differs),
+   then squeeze those bits together so field k's bit ends up at bit k */
+inline uint64_t compactDifferingFields(uint64_t difference, uint32_t bitsPerAnswer)
+{
+	if (bitsPerAnswer == 2)
+	{
+		uint64_t bits{ (difference | (difference >> 1)) & 0x5555555555555555ULL }; //bit 2k set if field k differs
+		bits = (bits | (bits >> 1)) & 0x3333333333333333ULL;
+		bits = (bits | (bits >> 2)) & 0x0F0F0F0F0F0F0F0FULL;
+		bits = (bits | (bits >> 4)) & 0x00FF00FF00FF00FFULL;
+		bits = (bits | (bits >> 8)) & 0x0000FFFF0000FFFFULL;
+		return (bits | (bits >> 16)) & 0x00000000FFFFFFFFULL;
+	}
+	uint64_t bits{ difference | (difference >> 1) };
+	bits = (bits | (bits >> 2)) & 0x1111111111111111ULL; //bit 4k set if field k differs
+	bits = (bits | (bits >> 3)) & 0x0303030303030303ULL;
+	bits = (bits | (bits >> 6)) & 0x000F000F000F000FULL;
+	bits = (bits | (bits >> 12)) & 0x000000FF000000FFULL;
+	return (bits | (bits >> 24)) & 0x000000000000FFFFULL;
+}
+
+/* Function to score straight from the packed answer rows : each row word is XORed with the packed answer key, and every answer field that
+   differs is a wrong answer. the wrong-question masks come out in the same layout as 'calculateContestantScores' produces, so reports and the summary work unchanged.
+   blank answers are found the same way, against a packed row of blanks, when the scoring scheme needs them */
+ScoringResults scorePackedContestants(const PackedContestants& packed, const unique_ptr<char[]>& correctAnswers, size_t numQuestions, size_t numThreads, const ScoringScheme& scheme)
+{
+	const PackedFileHeader& header = *packed.header;
+	size_t numContestants{ static_cast<size_t>(header.numContestants) };
+	size_t fieldsPerWord{ packed.fieldsPerWord() };
+	ScoringResults results = allocateScoringResults(numContestants, numQuestions, paddedRowStride(numQuestions) / cacheLineSize, scheme.scale);
+
+	//pack the answer key the same way; a key answer that no contestant ever gave cannot be encoded, so it is marked as always wrong instead
+	unique_ptr<uint64_t[]> packedKey(new uint64_t[header.rowWords]{});
+	unique_ptr<uint64_t[]> alwaysWrong(new uint64_t[header.rowWords]{}); //compacted bit k of word w set: question w * fieldsPerWord + k cannot be right
+	for (size_t j = 0; j < numQuestions; ++j)
+	{
+		const char* found = find(header.alphabet, header.alphabet + header.alphabetSize, *(correctAnswers.get() + j));
+		if (found == header.alphabet + header.alphabetSize)
+		{
+			*(alwaysWrong.get() + j / fieldsPerWord) |= uint64_t{ 1 } << (j % fieldsPerWord);
+		}
+		else
+		{
+			*(packedKey.get() + j / fieldsPerWord) |= static_cast<uint64_t>(found - header.alphabet) << ((j % fieldsPerWord) * header.bitsPerAnswer);
+		}
+	}
+
+	//a packed row of blank answers; if no contestant left anything blank, the blank answer is not in the alphabet and every question counts as answered
+	const char* blankCode = find(header.alphabet, header.alphabet + header.alphabetSize, scheme.blankAnswer);
+	bool blanksPossible{ blankCode != header.alphabet + header.alphabetSize };
+	unique_ptr<uint64_t[]> packedBlanks(new uint64_t[header.rowWords]{});
+	for (size_t j = 0; j < numQuestions && blanksPossible; ++j)
+	{
+		*(packedBlanks.get() + j / fieldsPerWord) |= static_cast<uint64_t>(blankCode - header.alphabet) << ((j % fieldsPerWord) * header.bitsPerAnswer);
+	}
+
+	auto scoreWith = [&](const auto& marking)
+	{
+		constexpr bool usesAnsweredMask{ remove_reference_t<decltype(marking)>::usesAnsweredMask };
+		scoreInParallel(numContestants, numQuestions, numThreads, results, [&](size_t begin, size_t end, WorkerTallies& tallies)
+		{
+			unique_ptr<uint64_t[]> answeredMask(usesAnsweredMask ? new uint64_t[results.maskWords] : nullptr);
+			for (size_t i = begin; i < end; ++i)
+			{
+				uint64_t* wrongMask = results.wrongQuestionMasks.get() + i * results.maskWords;
+				memset(wrongMask, 0, results.maskWords * sizeof(uint64_t));
+				const uint64_t* row = packed.row(i);
+				size_t wrongAnswerCount{ 0 };
+				for (size_t w = 0; w < header.rowWords; ++w)
+				{
+					//padding fields are zero in both the row and the key, so they never count as wrong
+					uint64_t wrongBits{ compactDifferingFields(*(row + w) ^ *(packedKey.get() + w), header.bitsPerAnswer) | *(alwaysWrong.get() + w) };
+					wrongAnswerCount += countSetBits(wrongBits);
+					size_t firstQuestion{ w * fieldsPerWord }; //fields per word divides 64, so a word's bits never straddle two mask words
+					*(wrongMask + firstQuestion / 64) |= wrongBits << (firstQuestion % 64);
+				}
+				if constexpr (usesAnsweredMask)
+				{
+					memset(answeredMask.get(), blanksPossible ? 0 : 0xFF, results.maskWords * sizeof(uint64_t));
+					for (size_t w = 0; w < header.rowWords && blanksPossible; ++w)
+					{
+						uint64_t answeredBits{ compactDifferingFields(*(row + w) ^ *(packedBlanks.get() + w), header.bitsPerAnswer) };
+						size_t firstQuestion{ w * fieldsPerWord };
+						*(answeredMask.get() + firstQuestion / 64) |= answeredBits << (firstQuestion % 64);
+					}
+				}
+				tallyContestant(results, tallies, i, wrongMask, marking.level(wrongMask, answeredMask.get(), numQuestions - wrongAnswerCount), 1);
+			}
+		});
+	};
+	switch (scheme.policy)
+	{
+	case ScoringPolicy::Plain:
+		scoreWith(PlainMarks{});
+		break;
+	case ScoringPolicy::Weighted:
+		scoreWith(WeightedMarks{ scheme, results.maskWords });
+		break;
+	case ScoringPolicy::NegativeMarking:
+		scoreWith(NegativeMarks{ scheme, results.maskWords });
+		break;
+	}
+	return results;
+}
+
+//Function to print out contestant reports for a packed file: only the wrong answers are decoded, into one reused row
+void printPackedContestantReports(ReportWriter& writer, const PackedContestants& packed, const ScoringResults& results, const unique_ptr<char[]>& correctAnswers, size_t numQuestions)
+{
+	unique_ptr<char[]> answerRow(new char[numQuestions + 1]{});
+	for (size_t i = 0; i < packed.header->numContestants; ++i)
+	{
+		const uint64_t* wrongMask = results.wrongQuestionMasks.get() + i * results.maskWords;
+		forEachWrongQuestion(wrongMask, results.maskWords, [&](size_t j) { *(answerRow.get() + j) = packed.answer(i, j); });
+		writer.writeContestant(packed.id(i), *(results.allScores.get() + i), wrongMask, results.maskWords, answerRow.get(), correctAnswers.get());
+	}
+}
+
+//Function to score a packed contestant file: map it, score from the packed rows, then print the reports and the summary
+void scorePackedContestantFile(const ProgramOptions& options, const unique_ptr<char[]>& correctAnswers, size_t numQuestions, const ScoringScheme& scheme)
+{
+	//the packed scoring pass never sees whole answers, only which ones differ from the key
+	if (!options.itemReportFilename.empty())
+	{
+		cerr << "--items needs the text contestant file, not a packed one.\n";
+		exit(1);
+	}
+	StageTimer loadTimer("load packed contestants");
+	MappedFile cfile(options.contestantsFilename);
+	if (!cfile.isOpen()) //if contestant file cannot be successfully opened
+	{
+		cerr << "contestant file could not be opened for reading.\n"; //print an error to the console
+		exit(1); //and exit the program
+	}
+	PackedContestants packed = openPackedContestants(cfile, numQuestions);
+	size_t numContestants{ static_cast<size_t>(packed.header->numContestants) };
+	loadTimer.addBytesRead(cfile.sizeInBytes());
+	loadTimer.addContestants(numContestants);
+	loadTimer.stop();
+
+	StageTimer scoringTimer("score packed");
+	ScoringResults results = scorePackedContestants(packed, correctAnswers, numQuestions, options.numThreads, scheme);
+	scoringTimer.addContestants(numContestants);
+	scoringTimer.stop();
+
+	StageTimer reportTimer(reportStageName(options.reportFormat));
+	ofstream reportFile{};
+	ReportWriter writer(openReportStream(options, reportFile), options.reportFormat, numQuestions);
+	printPackedContestantReports(writer, packed, results, correctAnswers, numQuestions);
+	writer.flush(); //reports must be out before the summary is printed
+	reportTimer.addBytesWritten(writer.bytesWritten());
+	reportTimer.addContestants(numContestants);
+	reportTimer.stop();
+
+	createReportSummary(cout, results.scoreHistogram, results.scale, numContestants, results.missedQuestionsCounter, numQuestions, options.percentiles);
+
+	if (options.queryContestants || !options.saveIndexFilename.empty())
+	{
+		StageTimer indexTimer("build index");
+		BuiltContestantIndex index = buildContestantIndex(numContestants, numQuestions, results, [&](size_t i) { return packed.id(i); });
+		indexTimer.addContestants(numContestants);
+		indexTimer.stop();
+		serveContestantIndex(options, index);
+	}
+}
+
+//Create an empty scoreboard for the given answer key
+LiveScoreboard::LiveScoreboard(const unique_ptr<char[]>& key, size_t numQuestions, ReportWriter* writer)
+	: numQuestions(numQuestions), correctAnswers(new char[numQuestions + 1]{}), scoreRow(selectRowScoringKernel()),
+	  scoreHistogram(new size_t[numQuestions + 1]{}), missedQuestionsCounter(new size_t[numQuestions]{}), writer(writer)
+{
+	memcpy(correctAnswers.get(), key.get(), numQuestions);
+	answerMatrix.rowStride = paddedRowStride(numQuestions);
+	paddedKey = allocateAlignedRows(1, answerMatrix.rowStride);
+	memcpy(paddedKey.get(), correctAnswers.get(), numQuestions);
+	wrongMask = unique_ptr<uint64_t[]>(new uint64_t[answerMatrix.rowStride / cacheLineSize]);
+}
+
+//Parse, score and add every contestant line in [begin, end); only these new contestants are compared against the key
+void LiveScoreboard::appendContestants(const char* begin, const char* end)
+{
+	StageTimer appendTimer("append contestants");
+	appendTimer.addBytesRead(static_cast<size_t>(end - begin));
+	size_t numContestantsBefore{ numContestants };
+	size_t maskWords{ answerMatrix.rowStride / cacheLineSize };
+	for (const char* cursor = skipWhitespace(begin, end); cursor < end; cursor = skipWhitespace(cursor, end))
+	{
+		//if the tables are full, double their size
+		if (numContestants == capacity)
+		{
+			size_t newCapacity{ max<size_t>(capacity * 2, 1024) };
+			growContestantTable(contestants, numContestants, newCapacity);
+			growAnswerMatrix(answerMatrix, numContestants, newCapacity);
+			unique_ptr<size_t[]> grownCounts(new size_t[newCapacity]);
+			copy(correctCounts.get(), correctCounts.get() + numContestants, grownCounts.get());
+			correctCounts = move(grownCounts);
+			capacity = newCapacity;
+		}
+
+		//read the contestant's line, then score it and add it to the running totals (live scoring always uses the plain scheme, so its blank answer)
+		const char* lineEnd = find(cursor, end, '\n');
+		parseContestant(cursor, lineEnd, numQuestions, defaultBlankAnswer, *(contestants.get() + numContestants), answerMatrix.row(numContestants));
+		cursor = lineEnd;
+		size_t correctAnswerCount{ numQuestions - scoreRow(answerMatrix.row(numContestants), paddedKey.get(), answerMatrix.rowStride, wrongMask.get()) };
+		forEachWrongQuestion(wrongMask.get(), maskWords, [&](size_t j) { *(missedQuestionsCounter.get() + j) += 1; });
+		*(scoreHistogram.get() + correctAnswerCount) += 1;
+		*(correctCounts.get() + numContestants) = correctAnswerCount;
+
+		if (writer != nullptr)
+		{
+			writer->writeContestant((contestants.get() + numContestants)->id, scoreForCorrectCount(correctAnswerCount, numQuestions), wrongMask.get(), maskWords, answerMatrix.row(numContestants), correctAnswers.get());
+		}
+		++numContestants;
+	}
+	appendTimer.addContestants(numContestants - numContestantsBefore);
+	if (writer != nullptr)
+	{
+		writer->flush();
+	}
+}
+
+/* Change one answer key entry and update everything that depends on it by rescanning only that question's column :
+   a contestant whose answer matched the old key entry loses a correct answer, one whose answer matches the new entry gains one,
+   and their histogram bucket and the question's miss counter move with them */
+bool LiveScoreboard::correctAnswerKey(size_t question, char answer)
+{
+	if (question >= numQuestions)
+	{
+		return false;
+	}
+	char oldAnswer{ *(correctAnswers.get() + question) };
+	for (size_t i = 0; i < numContestants; ++i)
+	{
+		char given{ *(answerMatrix.row(i) + question) };
+		bool wasCorrect{ given == oldAnswer };
+		bool isCorrect{ given == answer };
+		if (wasCorrect != isCorrect)
+		{
+			size_t& correctAnswerCount = *(correctCounts.get() + i);
+			*(scoreHistogram.get() + correctAnswerCount) -= 1;
+			correctAnswerCount = isCorrect ? correctAnswerCount + 1 : correctAnswerCount - 1;
+			*(scoreHistogram.get() + correctAnswerCount) += 1;
+			*(missedQuestionsCounter.get() + question) = isCorrect ? *(missedQuestionsCounter.get() + question) - 1 : *(missedQuestionsCounter.get() + question) + 1;
+		}
+	}
+	*(correctAnswers.get() + question) = answer;
+	*(paddedKey.get() + question) = answer;
+	return true;
+}
+
+//Print the current summary to the console
+void LiveScoreboard::printSummary(const vector<double>& percentiles)
+{
+	cout << "Contestants: " << numContestants << '\n';
+	createReportSummary(cout, scoreHistogram, correctCountScale(numQuestions), numContestants, missedQuestionsCounter, numQuestions, percentiles);
+	cout.flush();
+}
+
+/* Function to follow an append-only contestant file, handing every newly completed line to the scoreboard :
+   the file is checked every 'pollMilliseconds'; a line is only scored once its newline has arrived */
+void tailContestantFile(const string& filename, LiveScoreboard& scoreboard, size_t pollMilliseconds, const atomic<bool>& stopping)
+{
+	ifstream file(filename, ios::in | ios::binary);
+	if (!file) //if contestant file cannot be successfully opened
+	{
+		cerr << "contestant file could not be opened for reading.\n"; //print an error to the console
+		exit(1); //and exit the program
+	}
+	streamoff offset{ 0 };	//bytes of the file consumed so far
+	string pending{};		//bytes read but not yet part of a complete line
+
+	while (!stopping.load())
+	{
+		//find out how long the file is now, and read whatever was appended since the last check
+		file.clear();
+		file.seekg(0, ios::end);
+		streamoff size{ file.tellg() };
+		if (size > offset)
+		{
+			size_t previous{ pending.size() };
+			pending.resize(previous + static_cast<size_t>(size - offset));
+			file.seekg(offset);
+			file.read(&pending[previous], size - offset);
+			offset = size;
+
+			//score every complete line, and keep the unfinished last line (if any) for next time
+			size_t lastNewline{ pending.rfind('\n') };
+			if (lastNewline != string::npos)
+			{
+				{
+					lock_guard<mutex> guard(scoreboard.lock);
+					scoreboard.appendContestants(pending.data(), pending.data() + lastNewline + 1);
+				}
+				pending.erase(0, lastNewline + 1);
+			}
+		}
+		this_thread::sleep_for(chrono::milliseconds(pollMilliseconds));
+	}
+}
+
+/* Function to run as a long-lived live scorer ('--watch') :
+   a background thread tails the contestant file and scores new lines as they arrive, while commands read from standard input
+   ('summary', 'key <question> <answer>', 'quit') are answered from the scoreboard */
+void runLiveScoring(const ProgramOptions& options, const unique_ptr<char[]>& correctAnswers, size_t numQuestions)
+{
+	ofstream reportFile{};
+	unique_ptr<ReportWriter> writer{};
+	if (!options.reportFilename.empty()) //new contestants' reports go to the '--output' file; the console is the command channel
+	{
+		writer = make_unique<ReportWriter>(openReportStream(options, reportFile), options.reportFormat, numQuestions);
+	}
+	LiveScoreboard scoreboard(correctAnswers, numQuestions, writer.get());
+
+	atomic<bool> stopping{ false };
+	thread tailer(tailContestantFile, cref(options.contestantsFilename), ref(scoreboard), options.pollMilliseconds, cref(stopping));
+
+	//answer commands until 'quit' or the end of standard input
+	string line{};
+	while (getline(cin, line))
+	{
+		istringstream command(line);
+		string name{};
+		command >> name;
+		if (name == "summary")
+		{
+			lock_guard<mutex> guard(scoreboard.lock);
+			scoreboard.printSummary(options.percentiles);
+		}
+		else if (name == "key")
+		{
+			size_t question{ 0 };
+			char answer{};
+			bool changed{ false };
+			if (command >> question >> answer && question > 0)
+			{
+				lock_guard<mutex> guard(scoreboard.lock);
+				changed = scoreboard.correctAnswerKey(question - 1, answer); //questions are numbered from 1 on the command channel
+			}
+			cout << (changed ? "ok\n" : "error: usage is 'key <question number> <answer>'\n") << flush;
+		}
+		else if (name == "quit")
+		{
+			break;
+		}
+		else if (!name.empty())
+		{
+			cout << "error: commands are 'summary', 'key <question> <answer>' and 'quit'\n" << flush;
+		}
+	}
+	stopping.store(true);
+	tailer.join();
+}
+
+//Start 'numThreads' workers (at least one), all waiting for tasks
+ThreadPool::ThreadPool(size_t numThreads)
+{
+	numThreads = max<size_t>(numThreads, 1);
+	workers.reserve(numThreads);
+	for (size_t w = 0; w < numThreads; ++w)
+	{
+		workers.emplace_back(&ThreadPool::runWorker, this, w);
+	}
+}
+
+//Let the workers drain the queue, then join them
+ThreadPool::~ThreadPool()
+{
+	{
+		lock_guard<mutex> guard(lock);
+		stopping = true;
+	}
+	taskQueued.notify_all();
+	for (thread& worker : workers)
+	{
+		worker.join();
+	}
+}
+
+//Queue a task for the next free worker
+void ThreadPool::submit(function<void(size_t)> task)
+{
+	{
+		lock_guard<mutex> guard(lock);
+		tasks.push_back(move(task));
+		++unfinishedTasks;
+	}
+	taskQueued.notify_one();
+}
+
+//Block until every task submitted so far has finished
+void ThreadPool::wait()
+{
+	unique_lock<mutex> guard(lock);
+	allTasksDone.wait(guard, [this] { return unfinishedTasks == 0; });
+}
+
+//Body of each worker thread: take the oldest queued task, run it outside the lock, repeat until stopped and the queue is empty
+void ThreadPool::runWorker(size_t workerIndex)
+{
+	for (;;)
+	{
+		function<void(size_t)> task;
+		{
+			unique_lock<mutex> guard(lock);
+			taskQueued.wait(guard, [this] { return stopping || !tasks.empty(); });
+			if (tasks.empty()) //only reached when stopping
+			{
+				return;
+			}
+			task = move(tasks.front());
+			tasks.pop_front();
+		}
+		task(workerIndex);
+		{
+			lock_guard<mutex> guard(lock);
+			if (--unfinishedTasks == 0)
+			{
+				allTasksDone.notify_all();
+			}
+		}
+	}
+}
+
+/* Function to read a batch manifest : one quiz per line, given as 'answerFile contestantFile outputFile' separated by whitespace.
+   blank lines and lines starting with '#' are skipped; any other line without exactly three fields is an error */
+vector<QuizJob> readQuizManifest(const string& manifestFilename)
+{
+	ifstream manifest(manifestFilename);
+
+	//if manifest file cannot be successfully opened
+	if (!manifest)
+	{
+		cerr << "manifest file could not be opened for reading.\n"; //print an error to the console
+		exit(1); //and exit the program
+	}
+
+	vector<QuizJob> jobs;
+	string line;
+	for (size_t lineNumber = 1; getline(manifest, line); ++lineNumber)
+	{
+		istringstream fields(line);
+		QuizJob job{};
+		string extra;
+		if (!(fields >> job.answerKeyFilename) || job.answerKeyFilename.at(0) == '#')
+		{
+			continue; //blank line or comment
+		}
+		if (!(fields >> job.contestantsFilename >> job.outputFilename) || (fields >> extra))
+		{
+			cerr << manifestFilename << ':' << lineNumber << ": expected 'answerFile contestantFile outputFile'\n";
+			exit(1);
+		}
+		jobs.push_back(move(job));
+	}
+	return jobs;
+}
+
+/* Function to score one quiz of a batch run on the calling pool worker, using (and growing) that worker's workspace :
+   the reports go to the quiz's output file in the '--format' chosen. in text format the summary follows them in the same file,
+   exactly as a single run prints it to the console; other formats keep the report file loadable and put the summary in 'outputFile.summary'.
+   a quiz whose files cannot be opened is reported as failed instead of stopping the whole batch */
+QuizOutcome scoreQuiz(const QuizJob& job, const ProgramOptions& options, QuizWorkspace& workspace)
+{
+	QuizOutcome outcome{};
+	auto start = chrono::steady_clock::now();
+	StageTimer loadTimer("load quiz"); //'--stats' stages add up over all quizzes (and all workers)
+
+	//map both files and parse them into the workspace's contestant table and answer matrix
+	MappedFile afile(job.answerKeyFilename);
+	if (!afile.isOpen())
+	{
+		outcome.error = "answer file could not be opened for reading";
+		return outcome;
+	}
+	MappedFile cfile(job.contestantsFilename);
+	if (!cfile.isOpen())
+	{
+		outcome.error = "contestant file could not be opened for reading";
+		return outcome;
+	}
+	outcome.bytesRead = afile.sizeInBytes() + cfile.sizeInBytes();
+	unique_ptr<char[]> correctAnswers = parseAnswerKey(afile.begin(), afile.end(), outcome.numQuestions);
+	if (outcome.numQuestions == 0)
+	{
+		outcome.error = "answer file contains no answers";
+		return outcome;
+	}
+
+	//each quiz is scored with the scheme next to its own answer key, if it has one (read first, since its blank answer fills in short lines)
+	string schemeError{};
+	ScoringScheme scheme = loadScoringScheme(job.answerKeyFilename, outcome.numQuestions, schemeError);
+	if (!schemeError.empty())
+	{
+		outcome.error = schemeError; //only this quiz fails; the rest of the batch still runs
+		return outcome;
+	}
+	outcome.numContestants = parseContestantText(cfile.begin(), cfile.end(), outcome.numQuestions, scheme.blankAnswer, workspace.contestants, workspace.capacity, workspace.answerMatrix);
+	auto loaded = chrono::steady_clock::now();
+	loadTimer.addBytesRead(outcome.bytesRead);
+	loadTimer.addContestants(outcome.numContestants);
+	loadTimer.stop();
+
+	//the pool runs whole quizzes side by side, so each quiz is scored on a single thread
+	StageTimer scoringTimer("score");
+	ScoringResults results = calculateContestantScores(workspace.answerMatrix, outcome.numContestants, correctAnswers, outcome.numQuestions, 1, false, scheme);
+	auto scored = chrono::steady_clock::now();
+	scoringTimer.addContestants(outcome.numContestants);
+	scoringTimer.stop();
+
+	StageTimer reportTimer(reportStageName(options.reportFormat));
+
+	workspace.reportFile.clear(); //forget any failure from an earlier quiz
+	workspace.reportFile.open(job.outputFilename, ios::out | ios::binary | ios::trunc);
+	if (!workspace.reportFile)
+	{
+		outcome.error = "report file could not be opened for writing";
+		return outcome;
+	}
+	//the first quiz on this worker creates the report writer; later quizzes reuse it (and its buffer)
+	if (!workspace.writer)
+	{
+		workspace.writer = make_unique<ReportWriter>(workspace.reportFile, options.reportFormat, outcome.numQuestions);
+	}
+	else
+	{
+		workspace.writer->restart(workspace.reportFile, options.reportFormat, outcome.numQuestions);
+	}
+	printContestantReports(*workspace.writer, workspace.contestants, workspace.answerMatrix, results, outcome.numContestants, correctAnswers);
+	workspace.writer->flush(); //reports must be out before the summary is written
+	outcome.bytesWritten = workspace.writer->bytesWritten();
+	reportTimer.addBytesWritten(outcome.bytesWritten);
+	reportTimer.addContestants(outcome.numContestants);
+	reportTimer.stop();
+
+	if (options.reportFormat == ReportFormat::Text)
+	{
+		createReportSummary(workspace.reportFile, results.scoreHistogram, results.scale, outcome.numContestants, results.missedQuestionsCounter, outcome.numQuestions, options.percentiles);
+	}
+	else
+	{
+		ofstream summaryFile(job.outputFilename + ".summary");
+		createReportSummary(summaryFile, results.scoreHistogram, results.scale, outcome.numContestants, results.missedQuestionsCounter, outcome.numQuestions, options.percentiles);
+	}
+	workspace.reportFile.close();
+	if (!workspace.reportFile)
+	{
+		outcome.error = "report file could not be written";
+	}
+	auto written = chrono::steady_clock::now();
+
+	outcome.loadSeconds = chrono::duration<double>(loaded - start).count();
+	outcome.scoreSeconds = chrono::duration<double>(scored - loaded).count();
+	outcome.writeSeconds = chrono::duration<double>(written - scored).count();
+	return outcome;
+}
+
+/* Function to score every quiz listed in the '--batch' manifest in one process :
+   quizzes are handed to a pool of '--threads N' workers, each keeping its parse and output buffers from one quiz to the next.
+   when all are done, a timing report (one row per quiz in manifest order, then the totals) is printed to the console.
+   returns false if any quiz failed */
+bool runQuizBatch(const ProgramOptions& options)
+{
+	vector<QuizJob> jobs = readQuizManifest(options.manifestFilename);
+	vector<QuizOutcome> outcomes(jobs.size());
+
+	auto batchStart = chrono::steady_clock::now();
+	{
+		vector<QuizWorkspace> workspaces(max<size_t>(options.numThreads, 1)); //one per worker; outlives the pool
+		ThreadPool pool(workspaces.size());
+		for (size_t q = 0; q < jobs.size(); ++q)
+		{
+			pool.submit([&, q](size_t worker)
+			{
+				outcomes.at(q) = scoreQuiz(jobs.at(q), options, workspaces.at(worker));
+				outcomes.at(q).worker = worker;
+			});
+		}
+		pool.wait();
+	}
+	double wallSeconds{ chrono::duration<double>(chrono::steady_clock::now() - batchStart).count() };
+
+	//one row per quiz, in manifest order
+	size_t totalContestants{ 0 };
+	size_t totalBytesRead{ 0 };
+	size_t failedQuizzes{ 0 };
+	double busySeconds{ 0.0 };
+	cout << "quiz\tquestions\tcontestants\tload ms\tscore ms\twrite ms\tcontestants/s\tworker\tresult\n";
+	for (size_t q = 0; q < jobs.size(); ++q)
+	{
+		const QuizOutcome& outcome = outcomes.at(q);
+		if (!outcome.error.empty())
+		{
+			++failedQuizzes;
+			cout << jobs.at(q).contestantsFilename << "\t-\t-\t-\t-\t-\t-\t" << outcome.worker << '\t' << outcome.error << '\n';
+			continue;
+		}
+		double seconds{ outcome.loadSeconds + outcome.scoreSeconds + outcome.writeSeconds };
+		totalContestants += outcome.numContestants;
+		totalBytesRead += outcome.bytesRead;
+		busySeconds += seconds;
+		cout << jobs.at(q).contestantsFilename << '\t' << outcome.numQuestions << '\t' << outcome.numContestants << '\t' << fixed << setprecision(2)
+			 << outcome.loadSeconds * 1000.0 << '\t' << outcome.scoreSeconds * 1000.0 << '\t' << outcome.writeSeconds * 1000.0 << '\t'
+			 << setprecision(0) << (seconds > 0.0 ? static_cast<double>(outcome.numContestants) / seconds : 0.0) << '\t' << outcome.worker << "\tok\n";
+	}
+
+	//totals: busy time is the sum over quizzes, so busy / wall shows how well the pool overlapped them
+	cout << fixed << setprecision(2)
+		 << "Quizzes: " << jobs.size() << " (" << failedQuizzes << " failed) on " << max<size_t>(options.numThreads, 1) << " threads\n"
+		 << "Contestants: " << totalContestants << " (" << static_cast<double>(totalBytesRead) / (1024.0 * 1024.0) << " MB read)\n"
+		 << "Wall time: " << wallSeconds * 1000.0 << " ms, busy time: " << busySeconds * 1000.0 << " ms\n"
+		 << "Throughput: " << (wallSeconds > 0.0 ? static_cast<double>(jobs.size()) / wallSeconds : 0.0) << " quizzes/s, "
+		 << setprecision(0) << (wallSeconds > 0.0 ? static_cast<double>(totalContestants) / wallSeconds : 0.0) << " contestants/s\n";
+	return failedQuizzes == 0;
+}
+
+//Function to get the '--profile' name of an answer profile
+const char* answerProfileName(AnswerProfile profile)
+{
+	switch (profile)
+	{
+	case AnswerProfile::Uniform:
+		return "uniform";
+	case AnswerProfile::Clustered:
+		return "clustered";
+	default:
+		return "ability";
+	}
+}
+
+//Helper to start an independent random stream: stream 0 is the quiz itself, stream i + 1 is contestant i, later streams are shared answer sheets
+SplitMix64 randomStream(uint64_t seed, uint64_t stream)
+{
+	SplitMix64 mixer{ seed ^ (stream * 0xD1B54A32D192ED03ull) };
+	return SplitMix64{ mixer.next() };
+}
+
+//Helper to pick one generated answer: the correct one with probability 'correctChance', otherwise any option at random (which may still be correct)
+inline char generateAnswer(SplitMix64& random, char correctAnswer, double correctChance, const string& alphabet)
+{
+	if (random.nextUnit() < correctChance)
+	{
+		return correctAnswer;
+	}
+	return alphabet[random.below(alphabet.size())];
+}
+
+/* Function to write a synthetic quiz ('--generate', and the quizzes used by '--benchmark') in the usual file formats :
+   an answer key with one answer per line, and one line per contestant with a 10-digit id and space-separated answers.
+   every contestant draws from their own random stream, so the files depend only on the seed and the settings, never on how they are written.
+   returns the number of bytes written to the contestant file */
+size_t generateQuizFiles(const ProgramOptions& options, const string& answerKeyFilename, const string& contestantsFilename)
+{
+	size_t numQuestions{ options.generateQuestions };
+	size_t numContestants{ options.generateContestants };
+	const string& alphabet = options.alphabet;
+
+	//the answer key and a difficulty (0 = easy, 1 = hard) for every question
+	SplitMix64 quizRandom = randomStream(options.seed, 0);
+	unique_ptr<char[]> correctAnswers(new char[numQuestions]);
+	unique_ptr<double[]> difficulty(new double[numQuestions]);
+	for (size_t j = 0; j < numQuestions; ++j)
+	{
+		*(correctAnswers.get() + j) = alphabet[quizRandom.below(alphabet.size())];
+		*(difficulty.get() + j) = quizRandom.nextUnit();
+	}
+
+	//with the clustered profile, about one shared answer sheet per hundred contestants, each filled in like one able contestant would
+	size_t numSheets{ options.answerProfile == AnswerProfile::Clustered ? max<size_t>(numContestants / 100, 1) : 0 };
+	unique_ptr<char[]> sheets(new char[numSheets * numQuestions]);
+	for (size_t s = 0; s < numSheets; ++s)
+	{
+		SplitMix64 sheetRandom = randomStream(options.seed, numContestants + 1 + s);
+		double ability{ sheetRandom.nextUnit() };
+		for (size_t j = 0; j < numQuestions; ++j)
+		{
+			*(sheets.get() + s * numQuestions + j) = generateAnswer(sheetRandom, *(correctAnswers.get() + j), ability + 0.5 - *(difficulty.get() + j), alphabet);
+		}
+	}
+
+	ofstream keyFile(answerKeyFilename, ios::out | ios::binary | ios::trunc);
+	ofstream contestantFile(contestantsFilename, ios::out | ios::binary | ios::trunc);
+	if (!keyFile || !contestantFile) //if either file cannot be successfully opened
+	{
+		cerr << "generated quiz files could not be opened for writing.\n"; //print an error to the console
+		exit(1); //and exit the program
+	}
+	for (size_t j = 0; j < numQuestions; ++j)
+	{
+		keyFile << *(correctAnswers.get() + j) << '\n';
+	}
+
+	//contestant lines are formatted into one buffer and written in large blocks
+	size_t lineLength{ 10 + 2 * numQuestions + 1 };
+	size_t bufferSize{ max<size_t>(1024 * 1024, lineLength) };
+	unique_ptr<char[]> buffer(new char[bufferSize]);
+	size_t used{ 0 };
+	size_t totalBytes{ 0 };
+	for (size_t i = 0; i < numContestants; ++i)
+	{
+		if (used + lineLength > bufferSize)
+		{
+			contestantFile.write(buffer.get(), static_cast<streamsize>(used));
+			totalBytes += used;
+			used = 0;
+		}
+		//10-digit id, zero padded like the sample file's ids
+		char* line = buffer.get() + used;
+		uint64_t id{ i + 1 };
+		for (size_t digit = 10; digit-- > 0; id /= 10)
+		{
+			*(line + digit) = static_cast<char>('0' + id % 10);
+		}
+		char* answer = line + 10;
+
+		SplitMix64 random = randomStream(options.seed, i + 1);
+		if (options.answerProfile == AnswerProfile::Clustered)
+		{
+			//copy a shared sheet, changing about one answer in fifty
+			const char* sheet = sheets.get() + random.below(numSheets) * numQuestions;
+			for (size_t j = 0; j < numQuestions; ++j)
+			{
+				*answer++ = ' ';
+				*answer++ = generateAnswer(random, *(sheet + j), 0.98, alphabet);
+			}
+		}
+		else
+		{
+			//the ability profile gives able contestants a better chance on easy questions; the uniform profile ignores the key
+			double ability{ (random.nextUnit() + random.nextUnit()) / 2.0 };
+			for (size_t j = 0; j < numQuestions; ++j)
+			{
+				double correctChance{ options.answerProfile == AnswerProfile::Ability ? ability + 0.5 - *(difficulty.get() + j) : 0.0 };
+				*answer++ = ' ';
+				*answer++ = generateAnswer(random, *(correctAnswers.get() + j), correctChance, alphabet);
+			}
+		}
+		*answer++ = '\n';
+		used += static_cast<size_t>(answer - line);
+	}
+	contestantFile.write(buffer.get(), static_cast<streamsize>(used));
+	totalBytes += used;
+
+	if (!keyFile.flush() || !contestantFile.flush())
+	{
+		cerr << "generated quiz files could not be written.\n";
+		exit(1);
+	}
+	return totalBytes;
+}
+
+//Helper to run one benchmark stage 'repeats' times and return its fastest time in seconds
+template<typename Stage>
+double fastestRun(size_t repeats, Stage stage)
+{
+	double bestSeconds{ 0.0 };
+	for (size_t run = 0; run < repeats; ++run)
+	{
+		auto start = chrono::steady_clock::now();
+		stage();
+		double seconds{ chrono::duration<double>(chrono::steady_clock::now() - start).count() };
+		bestSeconds = (run == 0) ? seconds : min(bestSeconds, seconds);
+	}
+	return bestSeconds;
+}
+
+//Function to print one benchmark result as a JSON object on its own line
+void printBenchmarkResult(const ProgramOptions& options, size_t numContestants, const char* stage, double seconds, size_t bytes, size_t repeats)
+{
+	cout << "{\"stage\":\"" << stage << "\",\"contestants\":" << numContestants << ",\"questions\":" << options.generateQuestions
+		 << ",\"profile\":\"" << answerProfileName(options.answerProfile) << "\",\"threads\":" << options.numThreads
+		 << ",\"repeats\":" << repeats << ",\"bytes\":" << bytes << ',' << fixed << setprecision(9) << "\"seconds\":" << seconds
+		 << ',' << setprecision(0) << "\"contestants_per_s\":" << (seconds > 0.0 ? static_cast<double>(numContestants) / seconds : 0.0) << "}\n";
+	cout.flush();
+}
+
+/* Function to time every stage on its own ('--benchmark') for generated quizzes of 1000, 10000, ... up to '--bench-max' contestants :
+   load answer key, load contestants, scoring (with '--threads N'), summary statistics, most missed questions and contestant reports
+   (formatted in the '--format' chosen into a stream that discards them). small quizzes keep the fastest of five runs of each stage.
+   each result is one JSON object per line on the console, so runs can be saved and compared to catch regressions */
+void runBenchmarks(const ProgramOptions& options)
+{
+	//the quiz files go to the system temp directory, with a per-run suffix so runs side by side do not overwrite each other's files
+	error_code tempError{};
+	filesystem::path tempDirectory = filesystem::temp_directory_path(tempError);
+	if (tempError) //if there is no usable temp directory
+	{
+		cerr << "temporary directory could not be found for the benchmark files.\n"; //print an error to the console
+		exit(1); //and exit the program
+	}
+	string runSuffix{ to_string(chrono::steady_clock::now().time_since_epoch().count()) };
+	benchmarkTempFiles.answerKeyFilename = (tempDirectory / ("quiz_benchmark_key_" + runSuffix + ".tmp")).string();
+	benchmarkTempFiles.contestantsFilename = (tempDirectory / ("quiz_benchmark_contestants_" + runSuffix + ".tmp")).string();
+	const string answerKeyFilename{ benchmarkTempFiles.answerKeyFilename };
+	const string contestantsFilename{ benchmarkTempFiles.contestantsFilename };
+	signal(SIGINT, removeBenchmarkFilesOnSignal);
+	signal(SIGTERM, removeBenchmarkFilesOnSignal);
+	NullStreamBuffer discardBuffer;
+	ostream discard(&discardBuffer);
+	double checksum{ 0.0 }; //printed at the end so no stage can be optimised away
+
+	for (size_t numContestants = 1000; numContestants <= options.benchmarkMaxContestants; numContestants *= 10)
+	{
+		ProgramOptions settings = options;
+		settings.generateContestants = numContestants;
+		size_t contestantBytes{ generateQuizFiles(settings, answerKeyFilename, contestantsFilename) };
+		size_t repeats{ numContestants <= 100000 ? 5u : 1u };
+
+		size_t numQuestions{ 0 };
+		size_t answerKeyBytes{ 0 };
+		unique_ptr<char[]> correctAnswers{};
+		double seconds = fastestRun(repeats, [&] { numQuestions = 0; correctAnswers = processAnswerKey(answerKeyFilename, numQuestions, answerKeyBytes); });
+		printBenchmarkResult(settings, numContestants, "processAnswerKey", seconds, answerKeyBytes, repeats);
+
+		size_t loadedContestants{ 0 };
+		AnswerMatrix answerMatrix{};
+		unique_ptr<Contestant[]> contestants{};
+		seconds = fastestRun(repeats, [&]
+		{
+			loadedContestants = 0;
+			contestants = nullptr; //release the previous run's table first, so two copies are never held at once
+			answerMatrix = AnswerMatrix{};
+			contestants = processContestantFile(contestantsFilename, numQuestions, defaultBlankAnswer, loadedContestants, answerMatrix, contestantBytes);
+		});
+		printBenchmarkResult(settings, numContestants, "processContestantFile", seconds, contestantBytes, repeats);
+
+		ScoringResults results{};
+		ScoringScheme plainScheme = plainScoringScheme(numQuestions);
+		seconds = fastestRun(repeats, [&] { results = ScoringResults{}; results = calculateContestantScores(answerMatrix, loadedContestants, correctAnswers, numQuestions, options.numThreads, false, plainScheme); });
+		printBenchmarkResult(settings, numContestants, "calculateContestantScores", seconds, loadedContestants * answerMatrix.rowStride, repeats);
+
+		//the same pass under the other scoring policies: question j is worth 1 + j % 4 marks, and negative marking takes one mark off per wrong answer
+		vector<int64_t> correctMarks(numQuestions);
+		for (size_t j = 0; j < numQuestions; ++j)
+		{
+			correctMarks.at(j) = static_cast<int64_t>(1 + j % 4);
+		}
+		string schemeError{}; //these marks always fit the histogram
+		ScoringScheme policySchemes[]{ buildScoringScheme(correctMarks, vector<int64_t>(numQuestions, 0), '-', numQuestions, schemeError),
+			buildScoringScheme(correctMarks, vector<int64_t>(numQuestions, -1), '-', numQuestions, schemeError) };
+		for (const ScoringScheme& scheme : policySchemes)
+		{
+			ScoringResults policyResults{};
+			seconds = fastestRun(repeats, [&] { policyResults = ScoringResults{}; policyResults = calculateContestantScores(answerMatrix, loadedContestants, correctAnswers, numQuestions, options.numThreads, false, scheme); });
+			checksum += calculateMean(policyResults.scoreHistogram, policyResults.scale, loadedContestants);
+			string stage{ string("calculateContestantScores/") + scoringPolicyName(scheme.policy) };
+			printBenchmarkResult(settings, numContestants, stage.c_str(), seconds, loadedContestants * answerMatrix.rowStride, repeats);
+		}
+
+		seconds = fastestRun(repeats, [&]
+		{
+			checksum += calculateMean(results.scoreHistogram, results.scale, loadedContestants);
+			checksum += calculateMedian(results.scoreHistogram, results.scale, loadedContestants);
+			checksum += calculateModes(results.scoreHistogram, results.scale).front();
+		});
+		printBenchmarkResult(settings, numContestants, "calculateStatistics", seconds, 0, repeats);
+
+		seconds = fastestRun(repeats, [&] { printMostMissedQuestions(discard, results.missedQuestionsCounter, loadedContestants, numQuestions); });
+		printBenchmarkResult(settings, numContestants, "printMostMissedQuestions", seconds, 0, repeats);
+
+		size_t reportBytes{ 0 };
+		seconds = fastestRun(repeats, [&]
+		{
+			ReportWriter writer(discard, options.reportFormat, numQuestions);
+			printContestantReports(writer, contestants, answerMatrix, results, loadedContestants, correctAnswers);
+			writer.flush();
+			reportBytes = writer.bytesWritten();
+		});
+		printBenchmarkResult(settings, numContestants, "printContestantReports", seconds, reportBytes, repeats);
+
+		if (numContestants > options.benchmarkMaxContestants / 10) //the next size would overflow or pass the limit
+		{
+			break;
+		}
+	}
+
+	benchmarkTempFiles.removeAll();
+	cerr << "benchmark checksum: " << fixed << setprecision(2) << checksum << '\n';
+}
+
+/* Helper to find the proportion of an upper or lower scoring group (the top or bottom 'groupSize' contestants) who got question j right :
+   the group is taken from the score histogram, and contestants tied on the group boundary are counted in proportion */
+double groupProportionCorrect(const ItemCounts& items, const unique_ptr<size_t[]>& scoreHistogram, size_t numQuestions, size_t j, double groupSize, bool upperGroup)
+{
+	double remaining{ groupSize };
+	double correct{ 0.0 };
+	for (size_t step = 0; step <= numQuestions && remaining > 0.0; ++step)
+	{
+		size_t k{ upperGroup ? numQuestions - step : step };
+		double contestantsAtScore{ static_cast<double>(*(scoreHistogram.get() + k)) };
+		if (contestantsAtScore == 0.0)
+		{
+			continue;
+		}
+		double taken{ min(remaining, contestantsAtScore) };
+		correct += static_cast<double>(*(items.correctByScore.get() + j * (numQuestions + 1) + k)) * taken / contestantsAtScore;
+		remaining -= taken;
+	}
+	return correct / groupSize;
+}
+
+/* Function to write the item analysis ('--items FILE') as CSV, one row per question and answer option given (the key is always listed) :
+   question, key, p_value (proportion correct), point_biserial (of the key with the total score, item included),
+   upper_p and lower_p (proportion correct in the top and bottom 27% by total score) and discrimination (upper_p - lower_p),
+   then for the option: is_key, count, proportion, mean_score (mean score of those who chose it) and option_point_biserial.
+   correlations that are undefined (no spread in scores, or an option chosen by everyone or no one) are left empty */
+void writeItemReport(const string& filename, const ItemCounts& items, const unique_ptr<size_t[]>& scoreHistogram, const unique_ptr<char[]>& correctAnswers, size_t numQuestions, size_t numContestants)
+{
+	ofstream itemFile(filename, ios::out | ios::binary | ios::trunc);
+	if (!itemFile) //if item report file cannot be successfully opened
+	{
+		cerr << "item report file could not be opened for writing.\n"; //print an error to the console
+		exit(1); //and exit the program
+	}
+	itemFile << "question,key,p_value,point_biserial,upper_p,lower_p,discrimination,option,is_key,count,proportion,mean_score,option_point_biserial\n";
+	if (numContestants == 0)
+	{
+		return;
+	}
+
+	//mean and (population) standard deviation of the numbers of correct answers, from the histogram
+	double contestants{ static_cast<double>(numContestants) };
+	double sum{ 0.0 };
+	double sumOfSquares{ 0.0 };
+	for (size_t k = 0; k <= numQuestions; ++k)
+	{
+		double count{ static_cast<double>(*(scoreHistogram.get() + k)) };
+		sum += count * static_cast<double>(k);
+		sumOfSquares += count * static_cast<double>(k) * static_cast<double>(k);
+	}
+	double mean{ sum / contestants };
+	double deviation{ sqrt(max(sumOfSquares / contestants - mean * mean, 0.0)) };
+	double groupSize{ max(0.27 * contestants, 1.0) };
+
+	//point-biserial correlation of choosing an option with the total: (mean of choosers - overall mean) / sd * sqrt(p / (1 - p))
+	auto pointBiserial = [&](size_t count, size_t scoreSum, string& field)
+	{
+		double proportion{ static_cast<double>(count) / contestants };
+		field.clear();
+		if (deviation > 0.0 && count > 0 && count < numContestants)
+		{
+			double correlation{ (static_cast<double>(scoreSum) / static_cast<double>(count) - mean) / deviation * sqrt(proportion / (1.0 - proportion)) };
+			ostringstream formatted;
+			formatted << fixed << setprecision(4) << correlation;
+			field = formatted.str();
+		}
+	};
+
+	//answers are written as quoted CSV fields, so blanks and commas survive (a quote is doubled)
+	auto quoted = [](char answer) { return answer == '"' ? string("\"\"\"\"") : string("\"") + answer + '"'; };
+
+	string keyCorrelation;
+	string optionCorrelation;
+	for (size_t j = 0; j < numQuestions; ++j)
+	{
+		const size_t* tallies = items.optionTallies.get() + j * itemRowWords; //[count, score sum] per answer
+		unsigned char key{ static_cast<unsigned char>(*(correctAnswers.get() + j)) };
+		size_t keyCount{ *(tallies + 2 * key) };
+
+		double upperProportion{ groupProportionCorrect(items, scoreHistogram, numQuestions, j, groupSize, true) };
+		double lowerProportion{ groupProportionCorrect(items, scoreHistogram, numQuestions, j, groupSize, false) };
+		pointBiserial(keyCount, *(tallies + 2 * key + 1), keyCorrelation);
+
+		for (size_t option = 0; option < answerValues; ++option)
+		{
+			size_t count{ *(tallies + 2 * option) };
+			size_t scoreSum{ *(tallies + 2 * option + 1) };
+			if (count == 0 && option != key)
+			{
+				continue;
+			}
+			pointBiserial(count, scoreSum, optionCorrelation);
+			double meanScore{ count > 0 ? static_cast<double>(scoreSum) / static_cast<double>(count) / static_cast<double>(numQuestions) * 100.00 : 0.0 };
+			itemFile << (j + 1) << ',' << quoted(static_cast<char>(key)) << ',' << fixed << setprecision(4)
+					 << static_cast<double>(keyCount) / contestants << ',' << keyCorrelation << ','
+					 << upperProportion << ',' << lowerProportion << ',' << (upperProportion - lowerProportion) << ','
+					 << quoted(static_cast<char>(option)) << ',' << (option == key ? 1 : 0) << ',' << count << ','
+					 << static_cast<double>(count) / contestants << ',' << setprecision(2) << meanScore << ',' << optionCorrelation << '\n';
+		}
+	}
+	if (!itemFile.flush())
+	{
+		cerr << "item report file could not be written.\n";
+		exit(1);
+	}
+}
+
+/* Function to build the contestant index after scoring ('--query', '--save-index') :
+   ids come from 'idOf(i)', numbers of correct answers and wrong-question masks from the scoring results, and the cumulative score counts
+   from the score histogram. if an id appears more than once, lookups find its first contestant */
+template <typename IdOf>
+BuiltContestantIndex buildContestantIndex(size_t numContestants, size_t numQuestions, const ScoringResults& results, IdOf idOf)
+{
+	//lay the sections out one after another, keeping every section of 8-byte values 8-byte aligned
+	auto alignedTo8 = [](size_t offset) { return (offset + 7) / 8 * 8; };
+	IndexFileHeader header{};
+	memcpy(header.magic, "QIX1", sizeof(header.magic));
+	header.maskWords = static_cast<uint32_t>(results.maskWords);
+	header.numQuestions = numQuestions;
+	header.numContestants = numContestants;
+	header.tableSlots = 16;
+	while (header.tableSlots < 2 * numContestants)
+	{
+		header.tableSlots *= 2;
+	}
+	size_t idBytesSize{ 0 };
+	for (size_t i = 0; i < numContestants; ++i)
+	{
+		idBytesSize += idOf(i).size();
+	}
+	header.atOrAboveOffset = sizeof(IndexFileHeader);
+	header.slotsOffset = header.atOrAboveOffset + (numQuestions + 2) * sizeof(uint64_t);
+	header.idOffsetsOffset = header.slotsOffset + header.tableSlots * sizeof(IndexSlot);
+	header.idBytesOffset = header.idOffsetsOffset + (numContestants + 1) * sizeof(uint64_t);
+	header.correctCountsOffset = alignedTo8(header.idBytesOffset + idBytesSize);
+	header.wrongMasksOffset = alignedTo8(header.correctCountsOffset + numContestants * sizeof(uint32_t));
+	header.totalBytes = header.wrongMasksOffset + numContestants * results.maskWords * sizeof(uint64_t);
+
+	BuiltContestantIndex built{};
+	built.sizeInBytes = header.totalBytes;
+	built.data = allocateAligned<char>(built.sizeInBytes);
+	char* base = built.data.get();
+	memcpy(base, &header, sizeof(header));
+	built.index = openContestantIndex(base, built.sizeInBytes);
+	ContestantIndex& index = built.index;
+
+	//cumulative score counts: contestants with k or more correct answers, from the top down
+	uint64_t* atOrAbove = reinterpret_cast<uint64_t*>(base + header.atOrAboveOffset);
+	*(atOrAbove + numQuestions + 1) = 0;
+	for (size_t k = numQuestions + 1; k-- > 0;)
+	{
+		*(atOrAbove + k) = *(atOrAbove + k + 1) + *(results.scoreHistogram.get() + k);
+	}
+
+	//ids, numbers of correct answers (every answer not marked wrong) and wrong-question masks, one row per contestant
+	uint64_t* idOffsets = reinterpret_cast<uint64_t*>(base + header.idOffsetsOffset);
+	char* idBytes = base + header.idBytesOffset;
+	uint32_t* correctCounts = reinterpret_cast<uint32_t*>(base + header.correctCountsOffset);
+	for (size_t i = 0; i < numContestants; ++i)
+	{
+		string_view id = idOf(i);
+		memcpy(idBytes + *(idOffsets + i), id.data(), id.size());
+		*(idOffsets + i + 1) = *(idOffsets + i) + id.size();
+		const uint64_t* wrongMask = results.wrongQuestionMasks.get() + i * results.maskWords;
+		size_t wrongAnswerCount{ 0 };
+		for (size_t word = 0; word < results.maskWords; ++word)
+		{
+			wrongAnswerCount += countSetBits(*(wrongMask + word));
+		}
+		*(correctCounts + i) = static_cast<uint32_t>(numQuestions - wrongAnswerCount);
+	}
+	if (numContestants > 0)
+	{
+		memcpy(base + header.wrongMasksOffset, results.wrongQuestionMasks.get(), numContestants * results.maskWords * sizeof(uint64_t));
+	}
+
+	//hash table: every slot starts empty, then each contestant goes into the first free slot from its hash onwards
+	IndexSlot* slots = reinterpret_cast<IndexSlot*>(base + header.slotsOffset);
+	memset(static_cast<void*>(slots), 0xFF, header.tableSlots * sizeof(IndexSlot));
+	size_t duplicateIds{ 0 };
+	for (size_t i = 0; i < numContestants; ++i)
+	{
+		uint64_t hash{ hashContestantId(index.id(i)) };
+		uint64_t slot{ hash & (header.tableSlots - 1) };
+		bool duplicate{ false };
+		for (; (slots + slot)->row != ContestantIndex::notFound; slot = (slot + 1) & (header.tableSlots - 1))
+		{
+			if ((slots + slot)->hash == hash && index.id((slots + slot)->row) == index.id(i))
+			{
+				duplicate = true;
+				break;
+			}
+		}
+		if (duplicate)
+		{
+			++duplicateIds;
+			continue;
+		}
+		(slots + slot)->hash = hash;
+		(slots + slot)->row = i;
+	}
+	if (duplicateIds > 0)
+	{
+		cerr << duplicateIds << " contestant ids appear more than once; lookups return the first contestant with each id.\n";
+	}
+	return built;
+}
+
+//Function to check index bytes (built in memory or mapped from a file) and set up a view of their sections; exits with an error if they are damaged
+ContestantIndex openContestantIndex(const char* data, size_t sizeInBytes)
+{
+	const IndexFileHeader* header = reinterpret_cast<const IndexFileHeader*>(data);
+	bool valid{ sizeInBytes >= sizeof(IndexFileHeader) && memcmp(header->magic, "QIX1", 4) == 0 && header->totalBytes == sizeInBytes };
+	valid = valid && header->tableSlots >= 2 * header->numContestants && header->tableSlots > 0 && (header->tableSlots & (header->tableSlots - 1)) == 0;
+	//every count is bounded by the index size first, so none of the section sizes below can overflow
+	valid = valid && header->numQuestions <= sizeInBytes / 8 && header->numContestants <= sizeInBytes / 8 && header->maskWords <= sizeInBytes / 8 && header->tableSlots <= sizeInBytes / sizeof(IndexSlot);
+	valid = valid && header->maskWords * uint64_t{ 64 } >= header->numQuestions && header->atOrAboveOffset == sizeof(IndexFileHeader);
+	//sections follow one another in order, so checking each start against the end of the one before keeps them all inside the index
+	valid = valid && header->slotsOffset == header->atOrAboveOffset + (header->numQuestions + 2) * sizeof(uint64_t);
+	valid = valid && header->idOffsetsOffset == header->slotsOffset + header->tableSlots * sizeof(IndexSlot);
+	valid = valid && header->idBytesOffset == header->idOffsetsOffset + (header->numContestants + 1) * sizeof(uint64_t);
+	valid = valid && header->correctCountsOffset % 8 == 0 && header->correctCountsOffset >= header->idBytesOffset && header->correctCountsOffset <= sizeInBytes;
+	valid = valid && header->wrongMasksOffset % 8 == 0 && header->wrongMasksOffset >= header->correctCountsOffset + header->numContestants * sizeof(uint32_t);
+	valid = valid && header->wrongMasksOffset <= sizeInBytes && (header->maskWords == 0 || sectionFits(header->wrongMasksOffset, header->numContestants, header->maskWords * sizeof(uint64_t), sizeInBytes));
+	valid = valid && header->wrongMasksOffset + header->numContestants * header->maskWords * sizeof(uint64_t) == sizeInBytes;
+	if (!valid)
+	{
+		cerr << "contestant index is damaged.\n";
+		exit(1);
+	}
+	ContestantIndex index{};
+	index.header = header;
+	index.atOrAbove = reinterpret_cast<const uint64_t*>(data + header->atOrAboveOffset);
+	index.slots = reinterpret_cast<const IndexSlot*>(data + header->slotsOffset);
+	index.idOffsets = reinterpret_cast<const uint64_t*>(data + header->idOffsetsOffset);
+	index.idBytes = data + header->idBytesOffset;
+	index.correctCounts = reinterpret_cast<const uint32_t*>(data + header->correctCountsOffset);
+	index.wrongMasks = reinterpret_cast<const uint64_t*>(data + header->wrongMasksOffset);
+	return index;
+}
+
+/* Function to check the contents of an index mapped from a file before it answers queries (an index built in memory is right by construction) :
+   every id must lie inside the id bytes (so the id offsets may never go down), every used slot must point at a contestant,
+   at least one slot must be empty (so every probe ends), and every number of correct answers must have a cumulative score count; exits with an error otherwise */
+void checkContestantIndexContents(const ContestantIndex& index)
+{
+	const IndexFileHeader* header = index.header;
+	bool valid{ true };
+	for (size_t i = 0; valid && i < header->numContestants; ++i)
+	{
+		valid = *(index.idOffsets + i) <= *(index.idOffsets + i + 1);
+	}
+	valid = valid && *(index.idOffsets + header->numContestants) <= header->correctCountsOffset - header->idBytesOffset;
+	size_t emptySlots{ 0 };
+	for (size_t slot = 0; valid && slot < header->tableSlots; ++slot)
+	{
+		valid = (index.slots + slot)->row < header->numContestants || (index.slots + slot)->row == ContestantIndex::notFound;
+		emptySlots += (index.slots + slot)->row == ContestantIndex::notFound;
+	}
+	valid = valid && emptySlots > 0;
+	for (size_t i = 0; valid && i < header->numContestants; ++i)
+	{
+		valid = index.correctCount(i) <= header->numQuestions;
+	}
+	if (!valid)
+	{
+		cerr << "contestant index is damaged.\n";
+		exit(1);
+	}
+}
+
+/* Function to answer contestant queries : every line of 'in' is one id, answered with one tab-separated line on 'out' :
+   id, score, rank, number of contestants, percentile and the questions they got wrong (or '-'), or 'id<TAB>not found'.
+   output is flushed whenever no more input is waiting, so the queries can be typed in by hand or piped in bulk */
+void answerContestantQueries(const ContestantIndex& index, istream& in, ostream& out)
+{
+	string line;
+	while (getline(in, line))
+	{
+		const char* begin = skipWhitespace(line.data(), line.data() + line.size());
+		const char* end = begin;
+		while (end < line.data() + line.size() && !isWhitespace(*end))
+		{
+			++end;
+		}
+		if (begin == end)
+		{
+			continue; //blank line
+		}
+		string_view id(begin, static_cast<size_t>(end - begin));
+		size_t row{ index.find(id) };
+		out << id;
+		if (row == ContestantIndex::notFound)
+		{
+			out << "\tnot found\n";
+		}
+		else
+		{
+			size_t numQuestions{ static_cast<size_t>(index.header->numQuestions) };
+			out << '\t' << fixed << setprecision(2) << scoreForCorrectCount(index.correctCount(row), numQuestions) << '\t' << index.rank(row)
+				<< '\t' << index.header->numContestants << '\t' << index.percentile(row) << '\t';
+			bool anyWrong{ false };
+			forEachWrongQuestion(index.wrongMask(row), index.header->maskWords, [&](size_t j)
+			{
+				out << (anyWrong ? " " : "") << (j + 1);
+				anyWrong = true;
+			});
+			out << (anyWrong ? "\n" : "-\n");
+		}
+		if (in.rdbuf()->in_avail() <= 0)
+		{
+			out.flush();
+		}
+	}
+	out.flush();
+}
+
+//Function to save a built index ('--save-index') and/or answer queries from standard input with it ('--query')
+void serveContestantIndex(const ProgramOptions& options, const BuiltContestantIndex& built)
+{
+	if (!options.saveIndexFilename.empty())
+	{
+		ofstream indexFile(options.saveIndexFilename, ios::out | ios::binary | ios::trunc);
+		if (!indexFile || !indexFile.write(built.data.get(), static_cast<streamsize>(built.sizeInBytes)) || !indexFile.flush())
+		{
+			cerr << "index file could not be written.\n"; //print an error to the console
+			exit(1); //and exit the program
+		}
+	}
+	if (options.queryContestants)
+	{
+		answerContestantQueries(built.index, cin, cout);
+	}
+}
+
+//Function to answer queries from standard input with a saved index file ('--index FILE'), mapped and used in place without loading anything else
+void queryContestantIndexFile(const ProgramOptions& options)
+{
+	MappedFile indexFile(options.indexFilename);
+	if (!indexFile.isOpen()) //if index file cannot be successfully opened
+	{
+		cerr << "index file could not be opened for reading.\n"; //print an error to the console
+		exit(1); //and exit the program
+	}
+	ContestantIndex index = openContestantIndex(indexFile.begin(), indexFile.sizeInBytes());
+	checkContestantIndexContents(index);
+	answerContestantQueries(index, cin, cout);
+}
+
+/* Function to find the slice of the contestant text [begin, end) that shard 'shardIndex' of 'shardCount' scores :
+   the text is cut into equal byte ranges and each cut is moved forward to the start of the next line,
+   so every contestant line belongs to exactly one shard, whichever range it starts in */
+void findShardSlice(const char* begin, const char* end, size_t shardIndex, size_t shardCount, const char*& sliceBegin, const char*& sliceEnd)
+{
+	size_t sizeInBytes{ static_cast<size_t>(end - begin) };
+	auto lineStartAtOrAfter = [&](size_t cut) -> const char*
+	{
+		if (cut == 0)
+		{
+			return begin;
+		}
+		const char* newline = find(begin + cut - 1, end, '\n'); //a cut just after a newline is already a line start
+		return (newline == end) ? end : newline + 1;
+	};
+	//'size * k / N' without overflow: split size into whole multiples of N and a remainder below N (so 'remainder * k' fits, with at most 2^32 shards)
+	auto cutAt = [&](size_t k) { return sizeInBytes / shardCount * k + sizeInBytes % shardCount * k / shardCount; };
+	sliceBegin = lineStartAtOrAfter(cutAt(shardIndex - 1));
+	sliceEnd = lineStartAtOrAfter(cutAt(shardIndex));
+}
+
+//Function to fingerprint a quiz (answer key and scoring scheme), so partial summaries of different quizzes are never merged together
+uint64_t quizFingerprint(const unique_ptr<char[]>& correctAnswers, size_t numQuestions, const ScoringScheme& scheme)
+{
+	uint64_t hash{ hashBytes(correctAnswers.get(), numQuestions) };
+	int64_t scaleFields[3]{ static_cast<int64_t>(scheme.scale.levels), scheme.scale.lowestMarks, scheme.scale.totalMarks };
+	hash = hashBytes(scaleFields, sizeof(scaleFields), hash);
+	uint8_t policy{ static_cast<uint8_t>(scheme.policy) };
+	hash = hashBytes(&policy, 1, hash);
+	hash = hashBytes(&scheme.blankAnswer, 1, hash);
+	//the marks tables hold every question's marks, so two schemes with the same scale but different weights still differ
+	size_t tableBytes{ paddedRowStride(numQuestions) / cacheLineSize * marksTableWordEntries * sizeof(int32_t) };
+	if (scheme.correctMarkTable)
+	{
+		hash = hashBytes(scheme.correctMarkTable.get(), tableBytes, hash);
+	}
+	if (scheme.wrongMarkTable)
+	{
+		hash = hashBytes(scheme.wrongMarkTable.get(), tableBytes, hash);
+	}
+	return hash;
+}
+
+/* Function to score one shard of the contestant file ('--shard K/N --partial FILE') :
+   the shard's slice is parsed, scored and reported like a whole file, and instead of a summary it writes its partial summary,
+   so any number of shards can run as separate processes (on one machine or many) and '--merge' gives the summary of the whole file */
+void scoreContestantShard(const ProgramOptions& options, const unique_ptr<char[]>& correctAnswers, size_t numQuestions, const ScoringScheme& scheme)
+{
+	//map the whole contestant file, but parse only this shard's slice of it
+	StageTimer loadTimer("load shard");
+	MappedFile cfile(options.contestantsFilename);
+	if (!cfile.isOpen()) //if contestant file cannot be successfully opened
+	{
+		cerr << "contestant file could not be opened for reading.\n"; //print an error to the console
+		exit(1); //and exit the program
+	}
+	if (cfile.sizeInBytes() >= sizeof(PackedFileHeader) && memcmp(cfile.begin(), "QPK1", 4) == 0)
+	{
+		cerr << "a packed contestant file cannot be sharded; shard the text file it was compiled from.\n";
+		exit(1);
+	}
+	const char* sliceBegin = nullptr;
+	const char* sliceEnd = nullptr;
+	findShardSlice(cfile.begin(), cfile.end(), options.shardIndex, options.shardCount, sliceBegin, sliceEnd);
+	unique_ptr<Contestant[]> contestants{};
+	size_t capacity{ 0 };
+	AnswerMatrix answerMatrix{};
+	size_t numContestants{ parseContestantText(sliceBegin, sliceEnd, numQuestions, scheme.blankAnswer, contestants, capacity, answerMatrix) };
+	loadTimer.addBytesRead(static_cast<size_t>(sliceEnd - sliceBegin));
+	loadTimer.addContestants(numContestants);
+	loadTimer.stop();
+
+	StageTimer scoringTimer("score");
+	ScoringResults results = calculateContestantScores(answerMatrix, numContestants, correctAnswers, numQuestions, options.numThreads, false, scheme);
+	scoringTimer.addContestants(numContestants);
+	scoringTimer.stop();
+
+	//each shard reports its own contestants, in file order
+	ofstream reportFile{};
+	StageTimer reportTimer(reportStageName(options.reportFormat));
+	ReportWriter writer(openReportStream(options, reportFile), options.reportFormat, numQuestions);
+	printContestantReports(writer, contestants, answerMatrix, results, numContestants, correctAnswers);
+	writer.flush();
+	reportTimer.addBytesWritten(writer.bytesWritten());
+	reportTimer.addContestants(numContestants);
+	reportTimer.stop();
+
+	//the partial summary: header, then the histogram and the miss counters as u64
+	StageTimer partialTimer("write partial summary");
+	PartialSummaryHeader header{};
+	memcpy(header.magic, "QPS1", 4);
+	header.shardIndex = static_cast<uint32_t>(options.shardIndex);
+	header.shardCount = static_cast<uint32_t>(options.shardCount);
+	header.quizFingerprint = quizFingerprint(correctAnswers, numQuestions, scheme);
+	header.numQuestions = numQuestions;
+	header.numContestants = numContestants;
+	header.levels = results.scale.levels;
+	header.lowestMarks = results.scale.lowestMarks;
+	header.totalMarks = results.scale.totalMarks;
+	for (size_t level = 0; level < results.scale.levels; ++level)
+	{
+		header.marksSum += static_cast<int64_t>(*(results.scoreHistogram.get() + level)) * (results.scale.lowestMarks + static_cast<int64_t>(level));
+	}
+	header.sliceBegin = static_cast<uint64_t>(sliceBegin - cfile.begin());
+	header.sliceEnd = static_cast<uint64_t>(sliceEnd - cfile.begin());
+	size_t numCounts{ results.scale.levels + numQuestions };
+	unique_ptr<uint64_t[]> counts(new uint64_t[numCounts]);
+	copy(results.scoreHistogram.get(), results.scoreHistogram.get() + results.scale.levels, counts.get());
+	copy(results.missedQuestionsCounter.get(), results.missedQuestionsCounter.get() + numQuestions, counts.get() + results.scale.levels);
+	ofstream partialFile(options.partialFilename, ios::out | ios::binary | ios::trunc);
+	if (!partialFile || !partialFile.write(reinterpret_cast<const char*>(&header), sizeof(header))
+		|| !partialFile.write(reinterpret_cast<const char*>(counts.get()), static_cast<streamsize>(numCounts * sizeof(uint64_t))) || !partialFile.flush())
+	{
+		cerr << "partial summary file could not be written.\n"; //print an error to the console
+		exit(1); //and exit the program
+	}
+	partialTimer.addBytesWritten(sizeof(header) + numCounts * sizeof(uint64_t));
+}
+
+/* Function to print the summary of a sharded run from the partial summary of every shard ('--merge FILE...') :
+   the partials must all come from the same quiz and together cover every shard exactly once; their counts are added up
+   and summarised exactly as a single run over the whole contestant file would summarise its own */
+void mergePartialSummaries(const ProgramOptions& options)
+{
+	StageTimer mergeTimer("merge partial summaries");
+	PartialSummaryHeader first{};
+	vector<PartialSummaryHeader> headers{};
+	unique_ptr<size_t[]> scoreHistogram{};
+	unique_ptr<size_t[]> missedQuestionsCounter{};
+	size_t numContestants{ 0 };
+	for (const string& partialFilename : options.partialFilenames)
+	{
+		MappedFile partialFile(partialFilename);
+		if (!partialFile.isOpen()) //if partial summary file cannot be successfully opened
+		{
+			cerr << "partial summary " << partialFilename << " could not be opened for reading.\n"; //print an error to the console
+			exit(1); //and exit the program
+		}
+		mergeTimer.addBytesRead(partialFile.sizeInBytes());
+
+		//check the header, then that the counts it promises are all there and add up
+		PartialSummaryHeader header{};
+		bool valid{ partialFile.sizeInBytes() >= sizeof(header) };
+		if (valid)
+		{
+			memcpy(&header, partialFile.begin(), sizeof(header));
+		}
+		valid = valid && memcmp(header.magic, "QPS1", 4) == 0 && header.shardIndex >= 1 && header.shardIndex <= header.shardCount && header.sliceBegin <= header.sliceEnd;
+		valid = valid && header.levels > 0 && header.levels <= (partialFile.sizeInBytes() - sizeof(header)) / sizeof(uint64_t)
+			&& partialFile.sizeInBytes() == sizeof(header) + (header.levels + header.numQuestions) * sizeof(uint64_t);
+		const char* countsBegin = partialFile.begin() + sizeof(header);
+		auto countAt = [&](size_t k)
+		{
+			uint64_t count;
+			memcpy(&count, countsBegin + k * sizeof(uint64_t), sizeof(count));
+			return count;
+		};
+		uint64_t histogramTotal{ 0 };
+		int64_t marksSum{ 0 };
+		for (size_t level = 0; valid && level < header.levels; ++level)
+		{
+			histogramTotal += countAt(level);
+			marksSum += static_cast<int64_t>(countAt(level)) * (header.lowestMarks + static_cast<int64_t>(level));
+		}
+		for (size_t j = 0; valid && j < header.numQuestions; ++j)
+		{
+			valid = countAt(header.levels + j) <= header.numContestants;
+		}
+		valid = valid && histogramTotal == header.numContestants && marksSum == header.marksSum;
+		if (!valid)
+		{
+			cerr << "partial summary " << partialFilename << " is damaged.\n";
+			exit(1);
+		}
+
+		//every partial after the first must be another shard of the same quiz and the same split
+		if (headers.empty())
+		{
+			first = header;
+			scoreHistogram = unique_ptr<size_t[]>(new size_t[header.levels]{});
+			missedQuestionsCounter = unique_ptr<size_t[]>(new size_t[header.numQuestions]{});
+		}
+		else if (header.quizFingerprint != first.quizFingerprint || header.numQuestions != first.numQuestions || header.levels != first.levels
+			|| header.lowestMarks != first.lowestMarks || header.totalMarks != first.totalMarks)
+		{
+			cerr << "partial summary " << partialFilename << " is from a different quiz or scoring scheme than " << options.partialFilenames.front() << ".\n";
+			exit(1);
+		}
+		else if (header.shardCount != first.shardCount)
+		{
+			cerr << "partial summary " << partialFilename << " is shard " << header.shardIndex << "/" << header.shardCount
+				 << ", but " << options.partialFilenames.front() << " is from a run of " << first.shardCount << " shards.\n";
+			exit(1);
+		}
+		for (size_t level = 0; level < header.levels; ++level)
+		{
+			*(scoreHistogram.get() + level) += static_cast<size_t>(countAt(level));
+		}
+		for (size_t j = 0; j < header.numQuestions; ++j)
+		{
+			*(missedQuestionsCounter.get() + j) += static_cast<size_t>(countAt(header.levels + j));
+		}
+		numContestants += static_cast<size_t>(header.numContestants);
+		headers.push_back(header);
+	}
+
+	//every shard exactly once, and the shards' slices following one another from the start of the file
+	sort(headers.begin(), headers.end(), [](const PartialSummaryHeader& a, const PartialSummaryHeader& b) { return a.shardIndex < b.shardIndex; });
+	for (size_t k = 0; k < headers.size(); ++k)
+	{
+		if (k > 0 && headers.at(k).shardIndex == headers.at(k - 1).shardIndex)
+		{
+			cerr << "shard " << headers.at(k).shardIndex << "/" << first.shardCount << " is given more than once.\n";
+			exit(1);
+		}
+	}
+	if (headers.size() != first.shardCount)
+	{
+		cerr << "only " << headers.size() << " of the " << first.shardCount << " shards are given; every shard's partial summary is needed.\n";
+		exit(1);
+	}
+	for (size_t k = 0; k < headers.size(); ++k)
+	{
+		if (headers.at(k).sliceBegin != ((k == 0) ? 0 : headers.at(k - 1).sliceEnd))
+		{
+			cerr << "shard " << headers.at(k).shardIndex << "/" << first.shardCount << " does not continue where the shard before it ended; were the shards run on the same contestant file?\n";
+			exit(1);
+		}
+	}
+	mergeTimer.addContestants(numContestants);
+	mergeTimer.stop();
+
+	ScoreScale scale{ static_cast<size_t>(first.levels), first.lowestMarks, first.totalMarks };
+	createReportSummary(cout, scoreHistogram, scale, numContestants, missedQuestionsCounter, static_cast<size_t>(first.numQuestions), options.percentiles);
+}
+
+//Helper to hash the answers of a padded row 8 bytes at a time (the padding after the last answer is zero, so a partial last word hashes consistently)
+inline uint64_t hashAnswerRow(const char* row, size_t numQuestions)
+{
+	uint64_t hash{ 0x9E3779B97F4A7C15ull };
+	for (size_t offset = 0; offset < numQuestions; offset += sizeof(uint64_t))
+	{
+		uint64_t word;
+		memcpy(&word, row + offset, sizeof(word));
+		hash = (hash ^ word) * 0xFF51AFD7ED558CCDull;
+		hash ^= hash >> 32;
+	}
+	return hash;
+}
+
+/* Function to find the distinct answer rows of the loaded contestants ('--dedup') :
+   each row's hash is looked up in an open-addressing table (linear probing, never more than half full) of pattern numbers;
+   rows with the same hash are compared in full, and a new row is copied into the arena, which doubles as it fills */
+AnswerPatterns findAnswerPatterns(const AnswerMatrix& answerMatrix, size_t numContestants, size_t numQuestions)
+{
+	AnswerPatterns patterns{};
+	patterns.rows.rowStride = answerMatrix.rowStride;
+	patterns.patternOf = unique_ptr<size_t[]>(new size_t[numContestants]);
+	vector<size_t> contestantsWith{};
+
+	size_t tableSlots{ 16 };
+	while (tableSlots < 2 * numContestants)
+	{
+		tableSlots *= 2;
+	}
+	unique_ptr<IndexSlot[]> slots(new IndexSlot[tableSlots]);
+	for (size_t slot = 0; slot < tableSlots; ++slot)
+	{
+		(slots.get() + slot)->row = ContestantIndex::notFound;
+	}
+
+	for (size_t i = 0; i < numContestants; ++i)
+	{
+		const char* row = answerMatrix.row(i);
+		uint64_t hash{ hashAnswerRow(row, numQuestions) };
+		size_t slot{ static_cast<size_t>(hash) & (tableSlots - 1) };
+		while ((slots.get() + slot)->row != ContestantIndex::notFound
+			&& ((slots.get() + slot)->hash != hash || memcmp(patterns.rows.row((slots.get() + slot)->row), row, numQuestions) != 0))
+		{
+			slot = (slot + 1) & (tableSlots - 1);
+		}
+		IndexSlot* found = slots.get() + slot;
+		if (found->row == ContestantIndex::notFound)
+		{
+			//a new pattern: copy the row (padding and all) into the arena
+			if (patterns.numPatterns == patterns.rows.capacity)
+			{
+				growAnswerMatrix(patterns.rows, patterns.numPatterns, max<size_t>(2 * patterns.rows.capacity, 1024));
+			}
+			memcpy(patterns.rows.row(patterns.numPatterns), row, answerMatrix.rowStride);
+			found->hash = hash;
+			found->row = patterns.numPatterns++;
+			contestantsWith.push_back(0);
+		}
+		*(patterns.patternOf.get() + i) = static_cast<size_t>(found->row);
+		++contestantsWith.at(static_cast<size_t>(found->row));
+	}
+
+	patterns.contestantsWith = unique_ptr<size_t[]>(new size_t[patterns.numPatterns]);
+	copy(contestantsWith.begin(), contestantsWith.end(), patterns.contestantsWith.get());
+	return patterns;
+}
+
+/* Function to print every contestant's report, in file order, when the scores belong to answer patterns ('--dedup') :
+   patterns are numbered in order of first appearance, so each one's report text (all but the id) is formatted when it first
+   comes up and then copied for every later contestant with the same answers */
+void printPatternReports(ReportWriter& writer, const unique_ptr<Contestant[]>& contestants, const AnswerPatterns& patterns, const ScoringResults& results, size_t numContestants, const unique_ptr<char[]>& correctAnswers)
+{
+	string parts{};												  //formatted report text of every pattern so far, back to back
+	unique_ptr<size_t[]> partOffsets(new size_t[patterns.numPatterns + 1]); //where each pattern's text starts in 'parts'
+	*partOffsets.get() = 0;
+	size_t numFormatted{ 0 };
+	for (size_t i = 0; i < numContestants; ++i)
+	{
+		size_t pattern{ *(patterns.patternOf.get() + i) };
+		if (pattern == numFormatted)
+		{
+			writer.formatPatternPart(parts, *(results.allScores.get() + pattern), results.wrongQuestionMasks.get() + pattern * results.maskWords, results.maskWords,
+				patterns.rows.row(pattern), correctAnswers.get());
+			*(partOffsets.get() + ++numFormatted) = parts.size();
+		}
+		size_t offset{ *(partOffsets.get() + pattern) };
+		writer.writeContestant((contestants.get() + i)->id, string_view(parts.data() + offset, *(partOffsets.get() + pattern + 1) - offset));
+	}
+}
+
+/* Function to write every group of two or more contestants with identical answers to a CSV file ('--clusters FILE') :
+   one row per group, largest first (ties in order of first appearance): size, score, the wrong questions, and the ids in file order */
+void writeDuplicateClusters(const string& filename, const unique_ptr<Contestant[]>& contestants, const AnswerPatterns& patterns, const ScoringResults& results, size_t numContestants)
+{
+	ofstream clustersFile(filename, ios::out | ios::binary | ios::trunc);
+	if (!clustersFile) //if clusters file cannot be successfully opened
+	{
+		cerr << "clusters file could not be opened for writing.\n"; //print an error to the console
+		exit(1); //and exit the program
+	}
+
+	//group the contestants by pattern with a counting sort, so each group's ids come out in file order
+	unique_ptr<size_t[]> groupStart(new size_t[patterns.numPatterns + 1]);
+	*groupStart.get() = 0;
+	for (size_t p = 0; p < patterns.numPatterns; ++p)
+	{
+		*(groupStart.get() + p + 1) = *(groupStart.get() + p) + *(patterns.contestantsWith.get() + p);
+	}
+	unique_ptr<size_t[]> members(new size_t[numContestants]);
+	vector<size_t> filled(groupStart.get(), groupStart.get() + patterns.numPatterns);
+	for (size_t i = 0; i < numContestants; ++i)
+	{
+		*(members.get() + filled.at(*(patterns.patternOf.get() + i))++) = i;
+	}
+
+	vector<size_t> clusters{};
+	for (size_t p = 0; p < patterns.numPatterns; ++p)
+	{
+		if (*(patterns.contestantsWith.get() + p) > 1)
+		{
+			clusters.push_back(p);
+		}
+	}
+	stable_sort(clusters.begin(), clusters.end(), [&](size_t a, size_t b) { return *(patterns.contestantsWith.get() + a) > *(patterns.contestantsWith.get() + b); });
+
+	clustersFile << "contestants,score,wrong_questions,ids\n" << fixed << setprecision(2);
+	for (size_t p : clusters)
+	{
+		clustersFile << *(patterns.contestantsWith.get() + p) << ',' << *(results.allScores.get() + p) << ",\"";
+		bool first{ true };
+		forEachWrongQuestion(results.wrongQuestionMasks.get() + p * results.maskWords, results.maskWords, [&](size_t j)
+		{
+			clustersFile << (first ? "" : " ") << (j + 1);
+			first = false;
+		});
+		clustersFile << "\",\"";
+		for (size_t k = *(groupStart.get() + p); k < *(groupStart.get() + p + 1); ++k)
+		{
+			clustersFile << (k == *(groupStart.get() + p) ? "" : " ");
+			for (char c : string_view((contestants.get() + *(members.get() + k))->id))
+			{
+				if (c == '"')
+				{
+					clustersFile << '"'; //CSV escapes a quote by doubling it
+				}
+				clustersFile << c;
+			}
+		}
+		clustersFile << "\"\n";
+	}
+	if (!clustersFile.flush())
+	{
+		cerr << "clusters file could not be written.\n";
+		exit(1);
+	}
+}
 
-	//Call 'calculateContestantScores' function to calcaulate scores for each contestant based on their answers:
-	//create smart pointer for dynamic array and initialize with returned dynamic array of all contestants' scores from function call
-	unique_ptr<double[]> allScores = calculateContestantScores(contestants, numContestants, correctAnswers, numQuestions);
+/* Function to score the loaded contestants once per distinct answer row ('--dedup') :
+   blank sheets, perfect papers and copied answers all collapse into one pattern each, which is scored (counting once for every
+   contestant who gave it, so the summary is unchanged) and whose report text is formatted once. the deduplication ratio
+   (contestants per distinct row) goes to the error stream, and '--clusters' lists the groups of identical answer sheets */
+void scoreDeduplicatedContestants(const ProgramOptions& options, const unique_ptr<Contestant[]>& contestants, const AnswerMatrix& answerMatrix, size_t numContestants, const unique_ptr<char[]>& correctAnswers, size_t numQuestions, const ScoringScheme& scheme)
+{
+	StageTimer dedupTimer("deduplicate");
+	AnswerPatterns patterns = findAnswerPatterns(answerMatrix, numContestants, numQuestions);
+	dedupTimer.addContestants(numContestants);
+	dedupTimer.stop();
+	cerr << "dedup: " << numContestants << " contestants, " << patterns.numPatterns << " distinct answer rows, ratio " << fixed << setprecision(2)
+		 << (patterns.numPatterns > 0 ? static_cast<double>(numContestants) / static_cast<double>(patterns.numPatterns) : 1.0) << " ("
+		 << (numContestants > 0 ? static_cast<double>(numContestants - patterns.numPatterns) / static_cast<double>(numContestants) * 100.0 : 0.0)
+		 << "% of rows are duplicates)\n";
 
-	//Call 'printContestantReports' to print detailed report for each contestant
-	printContestantReports(contestants, allScores, numContestants, correctAnswers, numQuestions);
+	//each pattern counts once for every contestant who gave it, so the miss counters, histogram and item counts are those of all contestants
+	StageTimer scoringTimer("score");
+	bool analyseItems{ !options.itemReportFilename.empty() };
+	ScoringResults results = scoreAnswerRows(patterns.rows, patterns.numPatterns, correctAnswers, numQuestions, options.numThreads, analyseItems, scheme, patterns.contestantsWith.get());
+	scoringTimer.addContestants(numContestants);
+	scoringTimer.stop();
 
-	//Call 'sortScoresArray' to create a sorted scores dynamic array for report summary calculations
-	unique_ptr<double[]> sortedScores = sortScoresArray(allScores, numContestants);
+	ofstream reportFile{};
+	StageTimer reportTimer(reportStageName(options.reportFormat));
+	ReportWriter writer(openReportStream(options, reportFile), options.reportFormat, numQuestions);
+	printPatternReports(writer, contestants, patterns, results, numContestants, correctAnswers);
+	writer.flush(); //reports must be out before the summary is printed
+	reportTimer.addBytesWritten(writer.bytesWritten());
+	reportTimer.addContestants(numContestants);
+	reportTimer.stop();
 
-	//Call 'calculateModes' to find mode(s) for score distribution
-	vector<double> modes = calculateModes(sortedScores, numContestants);
+	createReportSummary(cout, results.scoreHistogram, results.scale, numContestants, results.missedQuestionsCounter, numQuestions, options.percentiles);
 
-	//call 'createReportSummary' to create and display summary report based on all contestants' scores:
-	//this includes calculating and displaying the mean, median, mode, and most missed questions
-	createReportSummary(allScores, numContestants, contestants, correctAnswers, numQuestions, sortedScores, modes);
+	if (analyseItems)
+	{
+		StageTimer itemTimer("item report");
+		writeItemReport(options.itemReportFilename, results.items, results.scoreHistogram, correctAnswers, numQuestions, numContestants);
+	}
 
-	return 0; //return 0 to indicate successful completion of program
+	if (!options.clustersFilename.empty())
+	{
+		StageTimer clustersTimer("duplicate clusters");
+		writeDuplicateClusters(options.clustersFilename, contestants, patterns, results, numContestants);
+	}
 }
 
-//Function to process the answer key file and store answers into dynamically allocated array
-unique_ptr<char[]> processAnswerKey(const string& answerKeyFilename, size_t& numQuestions) 
+//Function to pick where contestant reports go: the '--output' file (opened into 'reportFile'), or the console
+ostream& openReportStream(const ProgramOptions& options, ofstream& reportFile)
 {
-	//create input filestream object for answerkey file(in reading mode)
-	ifstream afile(answerKeyFilename, ios::in);
-
-	if (!afile) //if answer key file cannot be successfully opened
+	if (options.reportFilename.empty())
 	{
-		cerr << "answer file could not be opened for reading.\n"; //print an error to the console 
+		return cout;
+	}
+	reportFile.open(options.reportFilename, ios::out | ios::binary);
+	if (!reportFile) //if report file cannot be successfully opened
+	{
+		cerr << "report file could not be opened for writing.\n"; //print an error to the console
 		exit(1); //and exit the program
 	}
-	
-	char correctAnswer{}; //create temporary variable to hold each correct answer read from file
+	return reportFile;
+}
 
-	//read characters(correct answers) from answerkey file one by one until reaching the end
-	while (afile >> correctAnswer)
+//Function to get the '--format' name of a report format
+const char* reportFormatName(ReportFormat format)
+{
+	switch (format)
 	{
-		++numQuestions; //each time a character(answer) is read in, increase our numQuestions counter by one
+	case ReportFormat::Csv:
+		return "csv";
+	case ReportFormat::JsonLines:
+		return "json";
+	case ReportFormat::Binary:
+		return "binary";
+	default:
+		return "text";
 	}
+}
 
-	/* Allocate memory dynamically for storing correct answers :
-	   'unique_ptr<char[]>' is a smart pointer(stores memory address of another variable) providing automatic memory management
-	   'new char[numQuestions]' creates new array of characters with size equal to 'numQuestions' we counted above
-	    array is then managed by 'answers', which is our 'unique_ptr  */
-	unique_ptr<char[]> answers(new char[numQuestions]);
+//Function to get the '--stats' stage name for writing reports in a format, so the table shows which format the write throughput is for
+const char* reportStageName(ReportFormat format)
+{
+	switch (format)
+	{
+	case ReportFormat::Csv:
+		return "write reports (csv)";
+	case ReportFormat::JsonLines:
+		return "write reports (json)";
+	case ReportFormat::Binary:
+		return "write reports (binary)";
+	default:
+		return "write reports (text)";
+	}
+}
+
+//Function to print the mean of the scores
+void printMean(ostream& out, const unique_ptr<size_t[]>& scoreHistogram, const ScoreScale& scale, size_t numContestants)
+{
+	//print mean formatted to two decimal places
+	out << "Mean: " << fixed << setprecision(2) << calculateMean(scoreHistogram, scale, numContestants) << '\n'; 
+}
 
-	afile.clear();				//clear our end of file flag so the file can be read again
-	afile.seekg(0, ios::beg);	//move read position of file pointer back to the beginning
+//Function to print median of the scores
+void printMedian(ostream& out, const unique_ptr<size_t[]>& scoreHistogram, const ScoreScale& scale, size_t numContestants)
+{
+	//print median formatted to two decimal places
+	out << "Median: " << setprecision(2) << calculateMedian(scoreHistogram, scale, numContestants) << '\n';
+}
 
-	//iterate through each correct answer in the answerkey file
-	for (size_t i = 0; i < numQuestions; ++i)
-	 /* read correct answers into dynamic array managed by unique_ptr(smart pointer) :
-	    1. 'answers.get()' gets raw pointer from smart pointer which points to beginning of dynamic array
-	    2. Adding 'i' to this pointer moves location it points to forward by 'i' places 
-	    3. '*' before '(answers.get() + i)' dereferences pointer, meaning it gets value that's located at memory address now pointed to
-	    4. 'afile >>' reads one character from file and stores it in location pointed to by dereferenced pointer */
+//Function to print the calculated modes
+void printModes(ostream& out, const vector<double>& modes) 
+{
+	out << "Mode: ";
+	//for each mode in our modes vector
+	for (size_t i = 0; i < modes.size(); ++i)
 	{
-		afile >> *(answers.get() + i); 
+		out << setprecision(2) << modes.at(i); //print mode to two decimal places
+		if (i < modes.size() - 1)
+		{
+			out << ", "; //add comma if we are not on the last mode
+		}
 	}
-	afile.close(); //close answer key file
-	return answers; //return unique_ptr(smart pointer) managing dynamically allocated array of correct answers
+	out << '\n';
 }
 
-//Function to process the Contestant file; reads contestant data(id and contestant answers) into dynamically allocated array
-unique_ptr<Contestant[]> processContestantFile(const string& contestantsFilename, const size_t numQuestions, size_t& numContestants)	
+//Function to print each requested percentile of the scores
+void printPercentiles(ostream& out, const unique_ptr<size_t[]>& scoreHistogram, const ScoreScale& scale, size_t numContestants, const vector<double>& percentiles)
 {
-	//create input filestream object for contestant file(reading mode)
-	ifstream cfile(contestantsFilename, ios::in);
-
-	//if contestant file cannot be successfully opened
-	if (!cfile)
+	for (double percentile : percentiles)
 	{
-		cerr << "contestant file could not be opened for reading.\n"; //print an error to the console
-		exit(1); //and exit the program
+		//print percentile formatted to two decimal places, e.g. "P90: 85.00"
+		out << "P" << defaultfloat << setprecision(6) << percentile << ": " << fixed << setprecision(2) << calculatePercentile(scoreHistogram, scale, numContestants, percentile) << '\n';
 	}
+}
 
-	//create temporary variable to hold each line from file(in order to count number of lines - which is total number of contestants)_
-	string temp{};
+//Function to print mossed missed questions and their miss rate
+void printMostMissedQuestions(ostream& out, const unique_ptr<size_t[]>& missedQuestionsCounter, size_t numContestants, size_t numQuestions)
+{
+	//find most missed question(s) by contestants
+	out << "MOST MISSED QUESTIONS" << '\n';
 
-	//while there are still lines to process, store each line into temp string object (each line represents one contestant)
-	while (getline(cfile, temp)) 
+	//iterate through each question to calculate and display its miss rate
+	for (size_t j = 0; j < numQuestions; ++j)
 	{
-		++numContestants;  //increase number of contestants by one for each line read
-	}
+		//calculate miss rate for each question by dividing number of times it was missed by total number of contestants
+		double missRate{ static_cast<double>(*(missedQuestionsCounter.get() + j)) / static_cast<double>(numContestants) };
 
-	cfile.clear();				//after counting, clear our end of file flag so the file can be read again
-	cfile.seekg(0, ios::beg);   //move read position of file pointer back to the beginning
+		//if miss rate for question is 60% or higher, report it as a most missed question
+		if (missRate >= 0.60)
+		{
+			//print question number (adjusting from zero-based indexing by adding 1),
+			//print miss rate formatted as a percentage (multiply by 100 to convert from decimal to percentage)
+			out << (j + 1) << "\t" << setprecision(2) << (missRate * 100) << "%\n";
+		}
+	}
+}
 
-	//create dynamically allocated array of type 'Contestant'(holds the id and answers) with size of 'numContestants' counted above
-	unique_ptr<Contestant[]> contestants(new Contestant[numContestants]);
+//Function to make one heap allocation for the replacement 'operator new' below, counted while '--stats' is on; nullptr if there is no memory left
+void* allocateCounted(size_t size) noexcept
+{
+	if (countingAllocations)
+	{
+		allocationCount.fetch_add(1, memory_order_relaxed);
+	}
+	return malloc(size > 0 ? size : 1);
+}
 
-	//iterate through each contestant in file
-	for (size_t i = 0; i < numContestants; ++i)
+//Function to make one counted heap allocation aligned to 'alignment', or nullptr if there is no memory left
+void* allocateAlignedCounted(size_t size, align_val_t alignment) noexcept
+{
+	if (countingAllocations)
 	{
-		//read and store contestant's id number
-		cfile >> (contestants.get() + i) -> id;
+		allocationCount.fetch_add(1, memory_order_relaxed);
+	}
+	size_t align{ max(static_cast<size_t>(alignment), sizeof(void*)) };
+#if defined(_WIN32)
+	return _aligned_malloc(size > 0 ? size : 1, align);
+#else
+	void* memory = nullptr;
+	return posix_memalign(&memory, align, size > 0 ? size : 1) == 0 ? memory : nullptr;
+#endif
+}
 
-		//allocate memory for contestant's answers
-		(contestants.get() + i)->answers = unique_ptr<char[]>(new char[numQuestions]);
+//Function to release memory from 'allocateAlignedCounted'
+void freeAligned(void* memory) noexcept
+{
+#if defined(_WIN32)
+	_aligned_free(memory);
+#else
+	free(memory);
+#endif
+}
 
-		//iterate through each question for the contestant
-		for (size_t j = 0; j < numQuestions; ++j)
-		{
-			/* store each answer :
-			   1. '(contestants.get() + i)' gets address of ith contestant
-			   2. '->answers.get()' accesses unique_ptr managing answers array for this contestant
-			   3. Adding 'j' moves to correct position for this particular answer
-			   4. The '*' operator then 'dereferences'(gets the value for) this address, allowing us to store answer read from file */
-			cfile >> *((contestants.get() + i)->answers.get() + j);
-		}
+/* Replacement global allocation functions : the same as the standard ones, except that while '--stats' is on each call is counted.
+   every form is defined here (plain, array, aligned and nothrow, with their matching deletes), so each allocation is paired with these 'free' calls
+   whatever the standard library would otherwise forward to */
+void* operator new(size_t size)
+{
+	if (void* memory = allocateCounted(size))
+	{
+		return memory;
 	}
-	cfile.close(); //close contestant file
-	return contestants; //return unique_ptr managing dynamically allocated array of Contestants, which holds their IDs and answers
+	throw bad_alloc();
 }
 
-//Function to calculate contestant scores
-unique_ptr<double[]> calculateContestantScores(const unique_ptr<Contestant[]>& contestants, size_t numContestants, const unique_ptr<char[]>& correctAnswers, size_t numQuestions)
+void* operator new(size_t size, align_val_t alignment)
 {
-	//create dynamically allocated array to store scores for all contestants
-	unique_ptr<double[]> allScores(new double[numContestants]);
+	if (void* memory = allocateAlignedCounted(size, alignment))
+	{
+		return memory;
+	}
+	throw bad_alloc();
+}
 
-	//iterate through each contestant to calculate score and evaluate answers
-	for (size_t i = 0; i < numContestants; ++i)
+void* operator new[](size_t size)
+{
+	if (void* memory = allocateCounted(size))
 	{
-		size_t correctAnswerCount{ 0 }; //create variable to track number of correct answers for current contestant
-	
-		//for each question of current contestant
-		for (size_t j = 0; j < numQuestions; ++j)
-		{
-		//if correct answer matches the contestant answer
-			if (*(correctAnswers.get() + j) == *((contestants.get() + i)->answers.get() + j))
-			{
-			++correctAnswerCount; //increment correct answer counter by one
-			}
-		}
-		//calculate contestant's score and store it:
-		//divide number of correct answers by total number of questions to get score, multiply by 100 to get as percent
-		double score{ static_cast<double>(correctAnswerCount) / static_cast<double>(numQuestions) * 100.00 };
-		*(allScores.get() + i) = score; //assign calculated score to corresponding position in 'allScores' array
+		return memory;
 	}
-	return allScores; //return unique_ptr managing dynamically allocated array containing all scores
+	throw bad_alloc();
 }
 
-//Function to calculate mean of all the contestant scores
-double calculateMean(const unique_ptr<double[]>& allScores, size_t numContestants)
+void* operator new[](size_t size, align_val_t alignment)
 {
-	double sum{ 0.0 }; //start with sum of 0.0 to accumulate all scores
-	//iterate through each contestant
-	for (size_t i = 0; i < numContestants; ++i)
+	if (void* memory = allocateAlignedCounted(size, alignment))
 	{
-		sum += *(allScores.get() + i); //access the score of the ith contestant and add that to the sum
+		return memory;
 	}
-	//calculate mean by dividing total sum by total number of contestants
-	double mean{ sum / static_cast<double>(numContestants) };
+	throw bad_alloc();
+}
 
-	return mean; //return calculated mean
+void* operator new(size_t size, const nothrow_t&) noexcept { return allocateCounted(size); }
+void* operator new[](size_t size, const nothrow_t&) noexcept { return allocateCounted(size); }
+void* operator new(size_t size, align_val_t alignment, const nothrow_t&) noexcept { return allocateAlignedCounted(size, alignment); }
+void* operator new[](size_t size, align_val_t alignment, const nothrow_t&) noexcept { return allocateAlignedCounted(size, alignment); }
+
+//GCC's '-Wmismatched-new-delete' sees a 'delete' inlined next to a 'new' expression without looking into the replaced 'operator new' above,
+//so it takes the 'free' for a mismatch; with every form replaced here they always pair, and only that check is quietened for these definitions
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+#endif
+void operator delete(void* memory) noexcept { free(memory); }
+void operator delete[](void* memory) noexcept { free(memory); }
+void operator delete(void* memory, size_t) noexcept { free(memory); }
+void operator delete[](void* memory, size_t) noexcept { free(memory); }
+void operator delete(void* memory, const nothrow_t&) noexcept { free(memory); }
+void operator delete[](void* memory, const nothrow_t&) noexcept { free(memory); }
+void operator delete(void* memory, align_val_t) noexcept { freeAligned(memory); }
+void operator delete[](void* memory, align_val_t) noexcept { freeAligned(memory); }
+void operator delete(void* memory, size_t, align_val_t) noexcept { freeAligned(memory); }
+void operator delete[](void* memory, size_t, align_val_t) noexcept { freeAligned(memory); }
+void operator delete(void* memory, align_val_t, const nothrow_t&) noexcept { freeAligned(memory); }
+void operator delete[](void* memory, align_val_t, const nothrow_t&) noexcept { freeAligned(memory); }
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
+
+//Function to read the peak resident set size of the process so far, in bytes (0 where the system does not report it)
+size_t peakResidentBytes()
+{
+#if defined(_WIN32)
+	return 0;
+#else
+	rusage usage{};
+	getrusage(RUSAGE_SELF, &usage);
+#if defined(__APPLE__)
+	return static_cast<size_t>(usage.ru_maxrss); //already in bytes
+#else
+	return static_cast<size_t>(usage.ru_maxrss) * 1024; //in kilobytes
+#endif
+#endif
 }
 
-//Function to calculate the median of the contestants' scores
-double calculateMedian(const unique_ptr<double[]>& sortedScores, size_t numContestants)
+//Start collecting stage figures and counting allocations
+void PipelineStats::enable()
 {
-	//calculate median score from sorted scores array:
-	double median{ 0.0 }; //create median variable with value 0.0 (to be replaced with actual median)
+	enabled = true;
+	countingAllocations = true;
+}
 
-	if (numContestants % 2 == 1) //if we have an odd number of scores
+//Add one run of a stage to its totals, creating the stage the first time it is seen
+void PipelineStats::record(const StageTotals& run)
+{
+	lock_guard<mutex> guard(lock);
+	auto stage = find_if(stages.begin(), stages.end(), [&](const StageTotals& s) { return strcmp(s.name, run.name) == 0; });
+	if (stage == stages.end())
 	{
+		stages.push_back(run);
+		return;
+	}
+	stage->calls += run.calls;
+	stage->seconds += run.seconds;
+	stage->bytesRead += run.bytesRead;
+	stage->bytesWritten += run.bytesWritten;
+	stage->contestants += run.contestants;
+	stage->allocations += run.allocations;
+	stage->peakResidentBytes = max(stage->peakResidentBytes, run.peakResidentBytes);
+}
 
-		median = *(sortedScores.get() + (numContestants / 2)); //our median is the value at the middle index (numContestants/2)
+//Print the stage table: time, data moved and its MB/s, contestants per second, allocations and peak memory for every stage
+void PipelineStats::printTable(ostream& out) const
+{
+	lock_guard<mutex> guard(lock);
+	const double megabyte{ 1024.0 * 1024.0 };
+	out << "stage\tcalls\tms\tMB read\tMB/s read\tMB written\tMB/s written\tcontestants/s\tallocations\tpeak RSS MB\n";
+	for (const StageTotals& stage : stages)
+	{
+		out << stage.name << '\t' << stage.calls << '\t' << fixed << setprecision(2) << stage.seconds * 1000.0 << '\t'
+			<< static_cast<double>(stage.bytesRead) / megabyte << '\t' << stage.megabytesPerSecond(stage.bytesRead) << '\t'
+			<< static_cast<double>(stage.bytesWritten) / megabyte << '\t' << stage.megabytesPerSecond(stage.bytesWritten) << '\t'
+			<< setprecision(0) << (stage.seconds > 0.0 ? static_cast<double>(stage.contestants) / stage.seconds : 0.0) << '\t'
+			<< stage.allocations << '\t' << setprecision(2) << static_cast<double>(stage.peakResidentBytes) / megabyte << '\n';
 	}
-	else //otherwise, if we have an even number of scores
+	out << "total allocations: " << allocationCount.load() << ", peak RSS: " << static_cast<double>(peakResidentBytes()) / megabyte << " MB\n";
+}
+
+//Write the same figures as one JSON object, for monitoring
+void PipelineStats::writeJson(ostream& out) const
+{
+	lock_guard<mutex> guard(lock);
+	out << "{\"stages\":[";
+	for (size_t s = 0; s < stages.size(); ++s)
 	{
-		//the median is the average of the two middle scores located at indices [numContestants/2 - 1] and [numContestants / 2]
-		//add the value at the first middle index to the value at the second middle index, and divide the total by 2 to get the median
-		median = (*(sortedScores.get() + ((numContestants / 2) - 1)) + *(sortedScores.get() + (numContestants / 2))) / 2.0;
+		const StageTotals& stage = stages.at(s);
+		out << (s > 0 ? "," : "") << "{\"name\":\"" << stage.name << "\",\"calls\":" << stage.calls << ",\"seconds\":" << fixed << setprecision(9) << stage.seconds
+			<< ",\"bytes_read\":" << stage.bytesRead << ",\"read_mb_per_s\":" << setprecision(2) << stage.megabytesPerSecond(stage.bytesRead)
+			<< ",\"bytes_written\":" << stage.bytesWritten << ",\"written_mb_per_s\":" << stage.megabytesPerSecond(stage.bytesWritten) << ",\"contestants\":" << stage.contestants
+			<< ",\"contestants_per_s\":" << setprecision(0) << (stage.seconds > 0.0 ? static_cast<double>(stage.contestants) / stage.seconds : 0.0)
+			<< ",\"allocations\":" << stage.allocations << ",\"peak_rss_bytes\":" << stage.peakResidentBytes << '}';
 	}
-	return median; //return calculated median
+	out << "],\"total_allocations\":" << allocationCount.load() << ",\"peak_rss_bytes\":" << peakResidentBytes() << "}\n";
 }
 
-//Function to find the mode(s) of the scores
-vector<double> calculateModes(const unique_ptr<double[]>& sortedScores, size_t numContestants)
+//Start timing one run of the stage 'name' (a string literal), if collection is on
+StageTimer::StageTimer(const char* name)
 {
-	//create a vector to store the mode(s)
-	vector<double> modes;
+	if (!pipelineStats.isEnabled())
+	{
+		return;
+	}
+	run.name = name;
+	run.calls = 1;
+	running = true;
+	startAllocations = allocationCount.load(memory_order_relaxed);
+	start = chrono::steady_clock::now();
+}
 
-	double score = *(sortedScores.get()); //store first score as current score to compare against.
-	double previousScore{ score };		  //create variable previousScore with value of first score for comparison
-	size_t count{ 0 };					  //create count variable to track amount of times current score appears	
-	size_t highestFrequency{ 0 };		  //track highest frequency of any score seen so far
+//Finish timing and add the run to the stage's totals
+void StageTimer::stop()
+{
+	if (!running)
+	{
+		return;
+	}
+	running = false;
+	run.seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+	run.allocations = allocationCount.load(memory_order_relaxed) - startAllocations;
+	run.peakResidentBytes = peakResidentBytes();
+	pipelineStats.record(run);
+}
 
-	//iterate through all scores to find mode(s)
-	for (size_t i = 0; i <= numContestants; ++i)
+//Function to print the '--stats' table (to the error stream) and write the '--stats-json' file, once the run is over
+void reportPipelineStats(const ProgramOptions& options)
+{
+	if (!pipelineStats.isEnabled())
+	{
+		return;
+	}
+	if (options.showStats)
+	{
+		pipelineStats.printTable(cerr);
+	}
+	if (!options.statsJsonFilename.empty())
 	{
-		score = *(sortedScores.get() + i); //get current score in sortedScores array
-		if (score == previousScore) //if current score is same as previous score
+		ofstream statsFile(options.statsJsonFilename);
+		if (!statsFile) //if stats file cannot be successfully opened
 		{
-			++count; //increment our count by one
+			cerr << "stats file could not be opened for writing.\n"; //print an error to the console
+			return;
 		}
+		pipelineStats.writeJson(statsFile);
+	}
+}
 
-		//if we find new score or reach end of the sortedScores array
-		if (score != previousScore || i == numContestants)
+//Function to time the scoring pass with 1, 2, 4, ... up to 'maxThreads' threads and print the speedup table (to the error stream)
+void printScalingTable(const AnswerMatrix& answerMatrix, size_t numContestants, const unique_ptr<char[]>& correctAnswers, size_t numQuestions, size_t maxThreads, const ScoringScheme& scheme)
+{
+	cerr << "threads\tms\tspeedup\tcontestants/s\n";
+	double singleThreadSeconds{ 0.0 };
+	for (size_t threads = 1; threads <= maxThreads; threads = (threads * 2 > maxThreads && threads < maxThreads) ? maxThreads : threads * 2)
+	{
+		//keep the best of three runs to smooth out noise
+		double bestSeconds{ 0.0 };
+		for (int run = 0; run < 3; ++run)
 		{
-			//if count of previous score is higher than highest frequency seen so far
-			if (count > highestFrequency)
-			{
-				modes.clear();					//clear modes vector
-				modes.push_back(previousScore); //add this score to vector as new mode
-				highestFrequency = count;		//update the highest frequency seen so far
-			}
-			//if count of previous score equals highest frequency (case where we have multiple modes)
-			else if (count == highestFrequency)
-			{
-				modes.push_back(previousScore); //add score to modes vector without clearing it
-			}
-			//prepare for next score:	
-			count = 1; //reset count for new score
-			if (i != numContestants) //if we are not on the last score
-			{
-				previousScore = score; //update previousScore to current score
-			}
+			auto start = chrono::steady_clock::now();
+			calculateContestantScores(answerMatrix, numContestants, correctAnswers, numQuestions, threads, false, scheme);
+			double seconds{ chrono::duration<double>(chrono::steady_clock::now() - start).count() };
+			bestSeconds = (run == 0) ? seconds : min(bestSeconds, seconds);
+		}
+		if (threads == 1)
+		{
+			singleThreadSeconds = bestSeconds;
 		}
+		cerr << fixed << setprecision(2) << threads << '\t' << bestSeconds * 1000.0 << '\t' << (bestSeconds > 0.0 ? singleThreadSeconds / bestSeconds : 0.0)
+			 << '\t' << setprecision(0) << (bestSeconds > 0.0 ? static_cast<double>(numContestants) / bestSeconds : 0.0) << '\n';
 	}
-	return modes; //return our vector containing the mode(s)
 }
 
-//Function to sort the scores array in ascending order
-unique_ptr<double[]> sortScoresArray(const unique_ptr<double[]>& allScores, size_t numContestants)
+/* Function to score a contestant file in fixed-size batches ('--stream') :
+   each batch is read, scored and reported before the next one is read, and only the score histogram and
+   miss counters (both exact, and simply added together batch by batch) are kept for the summary.
+   peak memory depends on the batch size, not on the number of contestants, and the output matches the in-memory mode */
+void streamContestantFile(const ProgramOptions& options, const unique_ptr<char[]>& correctAnswers, size_t numQuestions, const ScoringScheme& scheme)
 {
-	//create new dynamically allocated array to hold sorted scores
-	unique_ptr<double[]> sortedScores(new double[numContestants]);
+	ContestantBatchReader reader(options.contestantsFilename, numQuestions, scheme.blankAnswer);
 
-	//copy all array values from allScores to sortedScores: 
-	for (size_t i = 0; i < numContestants; ++i)
+	//if contestant file cannot be successfully opened
+	if (!reader.isOpen())
 	{
-		// *(sortedScores.get() + i) = *(allScores.get() + i) copies the ith score to sortedScores array
-		*(sortedScores.get() + i) = *(allScores.get() + i);
+		cerr << "contestant file could not be opened for reading.\n"; //print an error to the console
+		exit(1); //and exit the program
 	}
 
-	/* Sort scores in ascending order using sort function :
-	   'sortedScores.get()' provides pointer to first element in array
-	   'sortedScores.get() + numContestants' provides a pointer just past last element,
-	    which gives sort function the correct range */
-	sort(sortedScores.get(), sortedScores.get() + numContestants);
-
-	return sortedScores; //return array of sorted scores
-}
+	//one batch worth of contestants and answer rows, reused for every batch
+	size_t batchSize{ max<size_t>(options.batchSize, 1) };
+	unique_ptr<Contestant[]> contestants(new Contestant[batchSize]);
+	AnswerMatrix answerMatrix{};
+	answerMatrix.rowStride = paddedRowStride(numQuestions);
+	answerMatrix.data = allocateAlignedRows(batchSize, answerMatrix.rowStride);
+	answerMatrix.capacity = batchSize;
 
-//Function to find most missed Questions(60% or higher miss rate)
-unique_ptr<size_t[]> findMostMissedQuestions(const unique_ptr<Contestant[]>& contestants, size_t numContestants, const unique_ptr<char[]>& correctAnswers, size_t numQuestions)
-{
-	//create dynamic array to count number of times each question was missed
-	//array is initialized with zeros, corresponding to each question
+	//running totals for the summary, added to after every batch
+	unique_ptr<size_t[]> scoreHistogram(new size_t[scheme.scale.levels]{});
 	unique_ptr<size_t[]> missedQuestionsCounter(new size_t[numQuestions]{});
+	size_t numContestants{ 0 };
+	bool analyseItems{ !options.itemReportFilename.empty() };
+	ItemCounts items = analyseItems ? allocateItemCounts(numQuestions) : ItemCounts{}; //item counts are plain sums too
 
-	//iterate through each contestant to evaluate their answers
-	for (size_t i = 0; i < numContestants; ++i)
+	//one report writer (and output buffer) for the whole file
+	ofstream reportFile{};
+	ReportWriter writer(openReportStream(options, reportFile), options.reportFormat, numQuestions);
+
+	for (;;)
 	{
-		//within each contestant, iterate through all questions to check their answers
-		for (size_t j = 0; j < numQuestions; ++j)
+		//read the next batch (each stage is timed per batch, and '--stats' shows the totals)
+		StageTimer readTimer("read batch");
+		size_t bytesBefore{ reader.bytesRead() };
+		size_t batchCount{ reader.readBatch(contestants, answerMatrix, batchSize) };
+		readTimer.addBytesRead(reader.bytesRead() - bytesBefore);
+		readTimer.addContestants(batchCount);
+		readTimer.stop();
+		if (batchCount == 0)
 		{
-			//if question was answered incorrectly (correct answer doesn't match contestant's answer)
-			if (*(correctAnswers.get() + j) != *((contestants.get() + i)->answers.get() + j))
-			{
-				//increment counter for that question in missedQuestionsCounter array
-				//this counts how many times each question was missed across all contestants
-				*(missedQuestionsCounter.get() + j) += 1;
-			}
+			break;
 		}
+
+		//score this batch, then print its reports right away
+		StageTimer scoringTimer("score");
+		ScoringResults results = calculateContestantScores(answerMatrix, batchCount, correctAnswers, numQuestions, options.numThreads, analyseItems, scheme);
+		scoringTimer.addContestants(batchCount);
+		scoringTimer.stop();
+
+		StageTimer reportTimer(reportStageName(options.reportFormat));
+		size_t bytesWrittenBefore{ writer.bytesWritten() };
+		printContestantReports(writer, contestants, answerMatrix, results, batchCount, correctAnswers);
+		reportTimer.addBytesWritten(writer.bytesWritten() - bytesWrittenBefore);
+		reportTimer.addContestants(batchCount);
+		reportTimer.stop();
+
+		//fold the batch into the running totals; the batch itself is overwritten by the next one
+		addBatchTotals(results, numQuestions, scoreHistogram, missedQuestionsCounter, analyseItems ? &items : nullptr);
+		numContestants += batchCount;
+	}
+
+	writer.flush(); //reports must be out before the summary is printed
+
+	//create and display summary report from the running totals
+	createReportSummary(cout, scoreHistogram, scheme.scale, numContestants, missedQuestionsCounter, numQuestions, options.percentiles);
+
+	//with '--items', write the item analysis from the running item counts
+	if (analyseItems)
+	{
+		StageTimer itemTimer("item report");
+		writeItemReport(options.itemReportFilename, items, scoreHistogram, correctAnswers, numQuestions, numContestants);
 	}
-	return missedQuestionsCounter; //return our missedQuestionsCounter array
 }
 
-//Function to print out contestant reports
-void printContestantReports(const unique_ptr<Contestant[]>& contestants, const unique_ptr<double[]>& allScores, size_t numContestants, const unique_ptr<char[]>& correctAnswers, size_t numQuestions)
+//Function to add one batch's counts to the running totals of a streamed or pipelined run (all plain sums, so the totals are exact)
+void addBatchTotals(const ScoringResults& results, size_t numQuestions, unique_ptr<size_t[]>& scoreHistogram, unique_ptr<size_t[]>& missedQuestionsCounter, ItemCounts* items)
 {
-	//iterate through each contestant 
-	for (size_t i = 0; i < numContestants; ++i)
+	for (size_t k = 0; k < results.scale.levels; ++k)
 	{
-		//display contestant ID and score to console
-		cout << (contestants.get() + i)->id << " - " << fixed << setprecision(2) << *(allScores.get() + i) << '\n'; 
-
-		/* allocate dynamic arrays to keep track of which questions were answered incorrectly
-		   'incorrectQuestionIndices' will hold indices of questions that were missed
-		   'incorrectAnswers' will hold what contestant answered for these missed questions */
-		unique_ptr<size_t[]> incorrectQuestionIndices(new size_t[numQuestions]);
-		unique_ptr<char[]> incorrectAnswers(new char[numQuestions]);
+		*(scoreHistogram.get() + k) += *(results.scoreHistogram.get() + k);
+	}
+	for (size_t j = 0; j < numQuestions; ++j)
+	{
+		*(missedQuestionsCounter.get() + j) += *(results.missedQuestionsCounter.get() + j);
+	}
+	if (items != nullptr)
+	{
+		addCounts(items->optionTallies.get(), results.items.optionTallies.get(), numQuestions * itemRowWords);
+		addCounts(items->correctByScore.get(), results.items.correctByScore.get(), numQuestions * (numQuestions + 1));
+	}
+}
 
-		size_t incorrectCount{ 0 }; //create variable to count number of incorrect answers
+//Create an empty queue that holds at most 'capacity' batches
+BatchQueue::BatchQueue(const char* name, size_t capacity)
+	: name(name), capacity(capacity)
+{
+}
 
-		for (size_t j = 0; j < numQuestions; ++j)
-		{
-			//if correct answer does not match the contestant answer
-			if (*(correctAnswers.get() + j) != *((contestants.get() + i)->answers.get() + j))
-			{
-				//store index(position) of incorrect question in 'inocrrectQuestionsIndices' array
-				*(incorrectQuestionIndices.get() + incorrectCount) = j; 
-				//store incorrect contestant answer in 'incorrectAnswers' array
-				*(incorrectAnswers.get() + incorrectCount) = *((contestants.get() + i)->answers.get() + j); 
-				++incorrectCount; //increment count of incorrect answers by one
-			}
-		}
+//Queue a batch, waiting first while the queue is full
+void BatchQueue::push(PipelineBatch* batch)
+{
+	unique_lock<mutex> guard(lock);
+	if (batches.size() >= capacity)
+	{
+		++fullWaits;
+		auto start = chrono::steady_clock::now();
+		notFull.wait(guard, [&] { return batches.size() < capacity; });
+		producerWaitSeconds += chrono::duration<double>(chrono::steady_clock::now() - start).count();
+	}
+	recordOccupancy();
+	batches.push_back(batch);
+	maxOccupancy = max(maxOccupancy, batches.size());
+	guard.unlock();
+	notEmpty.notify_one();
+}
 
-		//if contestant has any incorrect answers
-		if (incorrectCount > 0)
-		{
-			//iterate through incorrectQuestionIndices array to list out questions contestant missed
-			for (size_t k = 0; k < incorrectCount; ++k)
-			{
-				//print each missed questions number(add 1 since arrays start at index 0, and question numbers start at 1)
-				cout << *(incorrectQuestionIndices.get() + k) + 1 << " ";
-			}
-			cout << '\n'; //move to new line for separation
+//Take the oldest batch, waiting first while the queue is empty and still open
+PipelineBatch* BatchQueue::pop()
+{
+	unique_lock<mutex> guard(lock);
+	if (batches.empty() && !closed)
+	{
+		++emptyWaits;
+		auto start = chrono::steady_clock::now();
+		notEmpty.wait(guard, [&] { return !batches.empty() || closed; });
+		consumerWaitSeconds += chrono::duration<double>(chrono::steady_clock::now() - start).count();
+	}
+	if (batches.empty())
+	{
+		return nullptr; //closed, and every batch has been taken
+	}
+	recordOccupancy();
+	PipelineBatch* batch = batches.front();
+	batches.pop_front();
+	guard.unlock();
+	notFull.notify_one();
+	return batch;
+}
 
-			//iterate through incorrectAnswers array to display what contestant answered incorrectly
-			for (size_t k = 0; k < incorrectCount; ++k)
-			{
-				cout << *(incorrectAnswers.get() + k) << " "; //print each incorrect answer given by contestant
-			}
-			cout << '\n'; //move to new line for separation
+//Take the oldest batch if there is one, without waiting
+PipelineBatch* BatchQueue::tryPop()
+{
+	unique_lock<mutex> guard(lock);
+	if (batches.empty())
+	{
+		return nullptr;
+	}
+	recordOccupancy();
+	PipelineBatch* batch = batches.front();
+	batches.pop_front();
+	guard.unlock();
+	notFull.notify_one();
+	return batch;
+}
 
-			//iterate through array of incorrect answers to display correct answers for corresponding questions
-			for (size_t k = 0; k < incorrectCount; ++k)
-			{
-				/* print correct answer for each question contestant missed :
-				//access correct answer using the index from the incorrectQuestionIndices array,
-				//which points to corresponding question number that contestant got wrong. */
-				cout << *(correctAnswers.get() + *(incorrectQuestionIndices.get() + k)) << " ";
-			}
-			cout << '\n'; //move to new line separation
-		}
-		cout << '\n'; //add blank line for separation between contestant reports
+//Mark the queue as finished; consumers drain what is left, then 'pop' returns nullptr
+void BatchQueue::close()
+{
+	{
+		lock_guard<mutex> guard(lock);
+		closed = true;
 	}
+	notEmpty.notify_all();
 }
 
-//Function to print the mean of the scores
-void printMean(const unique_ptr<double[]>& allScores, size_t numContestants)
+//Add the time since the last push or pop, weighted by the number of batches queued during it
+void BatchQueue::recordOccupancy()
 {
-	//print mean formatted to two decimal places
-	cout << "Mean: " << setprecision(2) << calculateMean(allScores, numContestants) << '\n'; 
+	auto now = chrono::steady_clock::now();
+	batchSeconds += static_cast<double>(batches.size()) * chrono::duration<double>(now - lastChange).count();
+	lastChange = now;
 }
 
-//Function to print median of the scores
-void printMedian(const unique_ptr<double[]>& sortedScores, size_t numContestants)
+//Print one row of the occupancy readout: capacity, mean and peak occupancy, and how often and how long each side waited
+void BatchQueue::printOccupancy(ostream& out, double wallSeconds) const
 {
-	//print median formatted to two decimal places
-	cout << "Median: " << setprecision(2) << calculateMedian(sortedScores, numContestants) << '\n';
+	lock_guard<mutex> guard(lock);
+	out << name << '\t' << capacity << '\t' << fixed << setprecision(2) << (wallSeconds > 0.0 ? batchSeconds / wallSeconds : 0.0) << '\t' << maxOccupancy
+		<< '\t' << fullWaits << '\t' << producerWaitSeconds * 1000.0 << '\t' << emptyWaits << '\t' << consumerWaitSeconds * 1000.0 << '\n';
 }
 
-//Function to print the calculated modes
-void printModes(const vector<double>& modes) 
+/* Function to score a contestant file as a pipeline ('--pipeline') : a reader thread parses batches of 'batchSize' contestants,
+   '--threads' scoring workers each score whole batches, and the writer (this thread) prints their reports in input order.
+   the stages hand batches on through bounded queues of '--queue-depth' batches, and a fixed pool of batches (with their result arrays) is reused,
+   so a slow stage holds the others back (backpressure) and memory stays bounded however large the file is.
+   while one batch is read, others are scored and another is written, so the run takes about as long as its slowest stage.
+   reports and summary match the other modes; with '--stats', a queue-occupancy readout shows which stage is the bottleneck */
+void pipelineContestantFile(const ProgramOptions& options, const unique_ptr<char[]>& correctAnswers, size_t numQuestions, const ScoringScheme& scheme)
 {
-	cout << "Mode: ";
-	//for each mode in our modes vector
-	for (size_t i = 0; i < modes.size(); ++i)
+	ContestantBatchReader reader(options.contestantsFilename, numQuestions, scheme.blankAnswer);
+
+	//if contestant file cannot be successfully opened
+	if (!reader.isOpen())
 	{
-		cout << setprecision(2) << modes.at(i); //print mode to two decimal places
-		if (i < modes.size() - 1)
+		cerr << "contestant file could not be opened for reading.\n"; //print an error to the console
+		exit(1); //and exit the program
+	}
+
+	size_t batchSize{ max<size_t>(options.batchSize, 1) };
+	size_t numWorkers{ max<size_t>(options.numThreads, 1) };
+	size_t queueDepth{ max<size_t>(options.queueDepth, 1) };
+	bool analyseItems{ !options.itemReportFilename.empty() };
+
+	/* enough batches for both queues to be full while every worker and the writer hold one each;
+	   the reader allocates them as it first needs them, and waits for a written batch to come back once all are in use */
+	size_t poolSize{ 2 * queueDepth + numWorkers + 1 };
+	vector<unique_ptr<PipelineBatch>> pool{};
+	BatchQueue freeBatches("written -> read", poolSize);
+	BatchQueue readBatches("read -> score", queueDepth);
+	BatchQueue scoredBatches("score -> write", queueDepth);
+
+	//time each stage spends working (not waiting on a queue), for the readout
+	double readSeconds{ 0.0 };
+	atomic<uint64_t> scoreNanoseconds{ 0 };
+	double writeSeconds{ 0.0 };
+	auto start = chrono::steady_clock::now();
+
+	//the reader: fill a free batch (a new one while the pool is not full yet), then pass it on to the workers
+	thread readerThread([&]
+	{
+		for (size_t sequence = 0;; ++sequence)
 		{
-			cout << ", "; //add comma if we are not on the last mode
+			PipelineBatch* batch = freeBatches.tryPop();
+			if (batch == nullptr && pool.size() < poolSize)
+			{
+				pool.push_back(make_unique<PipelineBatch>());
+				batch = pool.back().get();
+				batch->contestants = unique_ptr<Contestant[]>(new Contestant[batchSize]);
+				batch->answerMatrix.rowStride = paddedRowStride(numQuestions);
+				batch->answerMatrix.data = allocateAlignedRows(batchSize, batch->answerMatrix.rowStride);
+				batch->answerMatrix.capacity = batchSize;
+				//the batch's result arrays are allocated once with it too, and scored into again every time it comes round
+				batch->results = allocateScoringResults(batchSize, numQuestions, batch->answerMatrix.rowStride / cacheLineSize, scheme.scale);
+				if (analyseItems)
+				{
+					batch->results.items = allocateItemCounts(numQuestions);
+				}
+			}
+			else if (batch == nullptr)
+			{
+				batch = freeBatches.pop();
+			}
+
+			auto readStart = chrono::steady_clock::now();
+			StageTimer readTimer("read batch");
+			size_t bytesBefore{ reader.bytesRead() };
+			batch->sequence = sequence;
+			batch->numContestants = reader.readBatch(batch->contestants, batch->answerMatrix, batchSize);
+			batch->bytesRead = reader.bytesRead() - bytesBefore;
+			readTimer.addBytesRead(batch->bytesRead);
+			readTimer.addContestants(batch->numContestants);
+			readTimer.stop();
+			readSeconds += chrono::duration<double>(chrono::steady_clock::now() - readStart).count();
+			if (batch->numContestants == 0)
+			{
+				break; //end of file: the empty batch is simply not used again
+			}
+			readBatches.push(batch);
 		}
-	}
-	cout << '\n';
-}
+		readBatches.close();
+	});
 
-//Function to print mossed missed questions and their miss rate
-void printMostMissedQuestions(const unique_ptr<size_t[]> missedQuestionsCounter, size_t numContestants, size_t numQuestions)
-{
-	//find most missed question(s) by contestants
-	cout << "MOST MISSED QUESTIONS" << '\n';
+	//the scoring workers: each scores whole batches on its own, and the last one to finish closes the writer's queue
+	atomic<size_t> workersRunning{ numWorkers };
+	vector<thread> workers{};
+	for (size_t w = 0; w < numWorkers; ++w)
+	{
+		workers.emplace_back([&]
+		{
+			while (PipelineBatch* batch = readBatches.pop())
+			{
+				auto scoreStart = chrono::steady_clock::now();
+				StageTimer scoringTimer("score");
+				scoreAnswerRowsInto(batch->results, batch->answerMatrix, batch->numContestants, correctAnswers, numQuestions, 1, scheme, nullptr);
+				scoringTimer.addContestants(batch->numContestants);
+				scoringTimer.stop();
+				scoreNanoseconds += static_cast<uint64_t>(chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - scoreStart).count());
+				scoredBatches.push(batch);
+			}
+			if (--workersRunning == 0)
+			{
+				scoredBatches.close();
+			}
+		});
+	}
 
-	//iterate through each question to calculate and display its miss rate
-	for (size_t j = 0; j < numQuestions; ++j)
+	//the writer: batches can finish scoring out of order, so each waits until every batch before it has been written
+	unique_ptr<size_t[]> scoreHistogram(new size_t[scheme.scale.levels]{});
+	unique_ptr<size_t[]> missedQuestionsCounter(new size_t[numQuestions]{});
+	size_t numContestants{ 0 };
+	ItemCounts items = analyseItems ? allocateItemCounts(numQuestions) : ItemCounts{};
+	ofstream reportFile{};
+	ReportWriter writer(openReportStream(options, reportFile), options.reportFormat, numQuestions);
+	vector<PipelineBatch*> waiting{}; //scored batches that arrived before the batch due next
+	size_t nextSequence{ 0 };
+	while (PipelineBatch* batch = scoredBatches.pop())
 	{
-		//calculate miss rate for each question by dividing number of times it was missed by total number of contestants
-		double missRate{ static_cast<double>(*(missedQuestionsCounter.get() + j)) / static_cast<double>(numContestants) };
+		waiting.push_back(batch);
+		for (auto due = find_if(waiting.begin(), waiting.end(), [&](PipelineBatch* b) { return b->sequence == nextSequence; }); due != waiting.end();
+			 due = find_if(waiting.begin(), waiting.end(), [&](PipelineBatch* b) { return b->sequence == nextSequence; }))
+		{
+			PipelineBatch* ready = *due;
+			waiting.erase(due);
+			auto writeStart = chrono::steady_clock::now();
+			StageTimer reportTimer(reportStageName(options.reportFormat));
+			size_t bytesWrittenBefore{ writer.bytesWritten() };
+			printContestantReports(writer, ready->contestants, ready->answerMatrix, ready->results, ready->numContestants, correctAnswers);
+			reportTimer.addBytesWritten(writer.bytesWritten() - bytesWrittenBefore);
+			reportTimer.addContestants(ready->numContestants);
+			reportTimer.stop();
+			addBatchTotals(ready->results, numQuestions, scoreHistogram, missedQuestionsCounter, analyseItems ? &items : nullptr);
+			numContestants += ready->numContestants;
+			writeSeconds += chrono::duration<double>(chrono::steady_clock::now() - writeStart).count();
+			++nextSequence;
+			freeBatches.push(ready); //back to the reader
+		}
+	}
+	readerThread.join();
+	for (thread& worker : workers)
+	{
+		worker.join();
+	}
+	writer.flush(); //reports must be out before the summary is printed
+	double wallSeconds{ chrono::duration<double>(chrono::steady_clock::now() - start).count() };
 
-		//if miss rate for question is 60% or higher, report it as a most missed question
-		if (missRate >= 0.60)
+	//with '--stats', show how busy each stage was and how full each queue ran: the busiest stage, with a full queue before it and an empty one after, is the bottleneck
+	if (options.showStats)
+	{
+		double busy[3]{ readSeconds, static_cast<double>(scoreNanoseconds.load()) / 1e9 / static_cast<double>(numWorkers), writeSeconds };
+		const char* stageNames[3]{ "read", "score", "write" };
+		size_t stageThreads[3]{ 1, numWorkers, 1 };
+		size_t bottleneck{ static_cast<size_t>(max_element(busy, busy + 3) - busy) };
+		cerr << "pipeline stage\tthreads\tbusy ms\tbusy %\n";
+		for (size_t k = 0; k < 3; ++k)
 		{
-			//print question number (adjusting from zero-based indexing by adding 1),
-			//print miss rate formatted as a percentage (multiply by 100 to convert from decimal to percentage)
-			cout << (j + 1) << "\t" << setprecision(2) << (missRate * 100) << "%\n";
+			cerr << stageNames[k] << '\t' << stageThreads[k] << '\t' << fixed << setprecision(2) << busy[k] * 1000.0 << '\t'
+				 << (wallSeconds > 0.0 ? busy[k] / wallSeconds * 100.0 : 0.0) << '\n';
 		}
+		cerr << "queue\tcapacity\tmean batches\tmax batches\tfull waits\tproducer wait ms\tempty waits\tconsumer wait ms\n";
+		readBatches.printOccupancy(cerr, wallSeconds);
+		scoredBatches.printOccupancy(cerr, wallSeconds);
+		freeBatches.printOccupancy(cerr, wallSeconds);
+		cerr << "pipeline: " << numContestants << " contestants in " << nextSequence << " batches, " << pool.size() << " batches allocated, "
+			 << setprecision(2) << wallSeconds * 1000.0 << " ms; bottleneck: " << stageNames[bottleneck] << '\n';
+	}
+
+	//create and display summary report from the running totals
+	createReportSummary(cout, scoreHistogram, scheme.scale, numContestants, missedQuestionsCounter, numQuestions, options.percentiles);
+
+	//with '--items', write the item analysis from the running item counts
+	if (analyseItems)
+	{
+		StageTimer itemTimer("item report");
+		writeItemReport(options.itemReportFilename, items, scoreHistogram, correctAnswers, numQuestions, numContestants);
 	}
 }
 
-//Function to create report summary for the contestants
-void createReportSummary(const unique_ptr<double[]>& allScores, size_t numContestants, const unique_ptr<Contestant[]>& contestants, const unique_ptr<char[]>& correctAnswers, size_t numQuestions, const unique_ptr<double[]>& sortedScores, const vector<double>& modes)
+//Function to create report summary for the contestants, written to 'out'
+void createReportSummary(ostream& out, const unique_ptr<size_t[]>& scoreHistogram, const ScoreScale& scale, size_t numContestants, const unique_ptr<size_t[]>& missedQuestionsCounter, size_t numQuestions, const vector<double>& percentiles)
 {
+	//with no contestants every statistic would divide by zero, so say so instead of printing NaN
+	if (numContestants == 0)
+	{
+		out << "No contestants were scored, so there are no statistics to report.\n";
+		return;
+	}
+
+	//time the statistics and the most missed questions as separate stages (for '--stats')
+	StageTimer statisticsTimer("summary statistics");
+
 	//print mean of all scores to console
-	printMean(allScores, numContestants);
+	printMean(out, scoreHistogram, scale, numContestants);
 
-	//sort array of all scores before calculating median and mode
-	sortScoresArray(allScores, numContestants);
-	
 	//print calculated median to console
-	printMedian(sortedScores, numContestants);
+	printMedian(out, scoreHistogram, scale, numContestants);
 
 	//print mode(s) to console
-	printModes(modes);
+	printModes(out, calculateModes(scoreHistogram, scale));
+
+	//print any percentiles asked for with '--percentile'
+	printPercentiles(out, scoreHistogram, scale, numContestants, percentiles);
+	statisticsTimer.stop();
 
+	StageTimer mostMissedTimer("most missed questions");
 	//if question has 60% or higher miss rate, print question number and corresponding miss rate
-	printMostMissedQuestions(findMostMissedQuestions(contestants, numContestants, correctAnswers, numQuestions), numContestants, numQuestions);	
+	//(the miss counters were filled in by the scoring pass)
+	printMostMissedQuestions(out, missedQuestionsCounter, numContestants, numQuestions);
 }